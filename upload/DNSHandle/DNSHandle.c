@@ -1,28 +1,5 @@
 #include "DNSHandle.h"
 
-static bool QueryForLocal(char *name, uint8_t ip_addrs[][4], int *ip_count, int *is_authoritative)
-{
-
-    // 使用新的多IP缓存查询
-    *ip_count = query_cache(name, ip_addrs, 10, is_authoritative);
-
-    if (*ip_count > 0)
-    {
-        if (debug_mode == 2)
-        {
-            debug_print2("Local query result: %s -> %d IP(s)\n", name, *ip_count);
-            for (int i = 0; i < *ip_count; i++)
-            {
-                debug_print2("  IP %d: %d.%d.%d.%d\n", i + 1,
-                             ip_addrs[i][0], ip_addrs[i][1], ip_addrs[i][2], ip_addrs[i][3]);
-            }
-        }
-        return true;
-    }
-
-    return false;
-}
-
 static bool SendToOtherServer(Task *t)
 {
 
@@ -42,109 +19,136 @@ static bool SendToOtherServer(Task *t)
 
     *(uint16_t *)(t->buf) = htons(server_ID);
 
-    sendto(servSock, t->buf, t->len, 0, (struct sockaddr *)&remoteSockAddr, sizeof(remoteSockAddr));
+    sendPacket(t->upstreamSock, t->buf, t->len, t->upstreamAddr);
     return true;
 }
 
-static void SendResponse(DnsMessage *dnsM, uint8_t ip_addrs[][4], int ip_count, struct sockaddr_in *client_addr, int is_authoritative)
+int DNSBuildInline(uint8_t *buf, int len, int size)
 {
-    uint8_t buffer_response[MAX_DNS_SIZE];
-
-    // 修改DNS头部以反映多个答案记录
-    dnsM->header->ancount = ip_count;
+    int nameLen;
 
-    uint8_t *response_ptr = set_message(dnsM, buffer_response, ip_addrs, ip_count, is_authoritative);
-    int len = response_ptr - buffer_response;
+    // 只处理标准查询（QR=0，opcode=0），且不带答案和授权部分
+    if (len < DNS_HEADER_SIZE || (buf[2] & 0xF8) != 0 ||
+        buf[6] != 0 || buf[7] != 0 || buf[8] != 0 || buf[9] != 0)
+    {
+        return 0;
+    }
+    int qend = get_question_end(buf, len);
+    int qtype = qend ? (buf[qend - 4] << 8) | buf[qend - 3] : 0;
+    if ((qtype != RR_A && qtype != QTYPE_AAAA) || ((buf[qend - 2] << 8) | buf[qend - 1]) != QCLASS_IN)
+    {
+        return 0;
+    }
+    // 先用存在性计数过滤，大部分未命中的查询不用加锁查表
+    if (!cache_may_contain(buf + DNS_HEADER_SIZE, len - DNS_HEADER_SIZE, &nameLen))
+    {
+        return 0;
+    }
 
-    sendto(servSock, buffer_response, len, 0,
-           (struct sockaddr *)client_addr, sizeof(*client_addr));
+    // 缓存里只有A记录，AAAA查询只能直接回答被屏蔽（0.0.0.0）的域名；按报文里的qname查，不转成点分字符串
+    int answer_len = answer_from_cache(buf, qend, size, 0);
+    if (answer_len > 0 && debug_mode)
+    {
+        char name[MAX_DOMAIN_NAME_LEN];
+        get_domain(buf + DNS_HEADER_SIZE, name, buf);
+        debug_print1("%d: *find from cache  %s, TYPE: %d, CLASS: %d (inline)\n",
+                     message_count++, name, qtype, QCLASS_IN);
+    }
+    return answer_len;
+}
 
-    debug_print2("send to client with %d IP(s)\n", ip_count);
+int DNSAnswerInline(Task *t)
+{
+    int len = DNSBuildInline((uint8_t *)(t->buf), t->len, MAX_DNS_SIZE);
+    if (len == 0)
+    {
+        return 0;
+    }
+    sendPacket(t->sock, t->buf, len, &(t->clientAddr));
+    stats_add(&stats.inline_hits, 1);
+    return 1;
 }
 
 void DNSHandle(Task *t)
 {
-    DnsMessage dnsM;
-    uint8_t *ptr = (uint8_t *)(t->buf); // 处理报文的函数需要使用，指向当前报文正在处理的位置
     uint8_t ip_addr[4];
 
-    switch (t->buf[3] & 0x80)
+    switch (t->buf[2] & 0x80)
     {
     case QUERY_MESSAGE:
         // printf("go to 1\n");
-        get_message(&dnsM, ptr, (uint8_t *)(t->buf));
-        if (dnsM.header->opcode == STANDARD_QUERY)
+        // 只有单个完整问题的标准A查询才从缓存回答：直接用报文里的qname查表，命中时不解析报文，
+        // 头部和问题沿用查询报文，接上缓存里预编码的答案
+        if (((t->buf[2] >> 3) & 0x0F) == STANDARD_QUERY)
         {
-            // printf("go to 1.1\n");
-            // TODO：如果不止有一个问题的话，需要加上for循环，并且需要更改后续处理流程，相当复杂
-            if (dnsM.questions->qtype == RR_A)
+            uint8_t *buf = (uint8_t *)(t->buf);
+            int qend = get_question_end(buf, t->len);
+            if (qend && ((buf[qend - 4] << 8) | buf[qend - 3]) == RR_A)
             {
-                // 查询缓存，获取所有IP地址
-                uint8_t ip_addrs[10][4]; // 最多支持10个IP地址
-                int ip_count;
-                int is_authoritative;
-
-                if (!QueryForLocal(dnsM.questions->qname, ip_addrs, &ip_count, &is_authoritative))
+                int answer_len = answer_from_cache(buf, qend, MAX_DNS_SIZE, 1);
+                if (answer_len > 0)
                 {
-                    debug_print1("%d: @send to upstream %s, TYPE: %d, CLASS: %d\n",
-                                 message_count++, dnsM.questions->qname,
-                                 dnsM.questions->qtype, dnsM.questions->qclass);
-                    if (!SendToOtherServer(t))
+                    sendPacket(t->sock, t->buf, answer_len, &(t->clientAddr));
+                    if (debug_mode)
                     {
-                        free_message(&dnsM);
+                        char qname[MAX_DOMAIN_NAME_LEN];
+                        get_domain(buf + DNS_HEADER_SIZE, qname, buf);
+                        debug_print1("%d: *find from cache  %s, TYPE: %d, CLASS: %d\n",
+                                     message_count++, qname, RR_A,
+                                     (buf[qend - 2] << 8) | buf[qend - 1]);
                     }
                     return;
                 }
-                else
-                {
-                    SendResponse(&dnsM, ip_addrs, ip_count, &(t->clientAddr), is_authoritative);
-                    debug_print1("%d: *find from cache  %s, TYPE: %d, CLASS: %d\n",
-                                 message_count++, dnsM.questions->qname,
-                                 dnsM.questions->qtype, dnsM.questions->qclass);
-                    free_message(&dnsM);
-
-                    return;
-                }
             }
-            else
+        }
+
+        // 未命中的查询原样转发，不用解析报文；调试输出和命中时一样只解码qname
+        if (debug_mode && ((t->buf[2] >> 3) & 0x0F) == STANDARD_QUERY)
+        {
+            uint8_t *buf = (uint8_t *)(t->buf);
+            int qend = get_question_end(buf, t->len);
+            if (qend)
             {
-                SendToOtherServer(t);
+                char qname[MAX_DOMAIN_NAME_LEN];
+                get_domain(buf + DNS_HEADER_SIZE, qname, buf);
                 debug_print1("%d: @send to upstream %s, TYPE: %d, CLASS: %d\n",
-                             message_count++, dnsM.questions->qname,
-                             dnsM.questions->qtype, dnsM.questions->qclass);
-
-                free_message(&dnsM);
+                             message_count++, qname, (buf[qend - 4] << 8) | buf[qend - 3],
+                             (buf[qend - 2] << 8) | buf[qend - 1]);
             }
         }
-        else
-        {
-            SendToOtherServer(t);
-        }
-        free_message(&dnsM);
+        SendToOtherServer(t);
         break;
     case RESPONSE_MESSAGE:
         // printf("go to 2\n");
-        get_message(&dnsM, ptr, (uint8_t *)(t->buf));
+        // 上游应答只读头部和问题，只有要写进缓存的应答才逐条看答案记录，其余原样转发
         debug_print2("received from upstream server\n");
+        if (t->len < DNS_HEADER_SIZE)
+        {
+            return;
+        }
 
-        uint16_t server_ID = dnsM.header->id;
+        uint8_t *buf = (uint8_t *)(t->buf);
+        uint16_t server_ID = (buf[0] << 8) | buf[1];
         uint16_t client_ID = 0;
         struct sockaddr_in original_client_addr;
 
         if (get_client_info(server_ID, &original_client_addr, &client_ID) == 0)
         {
             debug_print1("\nno match id\n");
-            free_message(&dnsM);
             return;
         }
 
+        // 直接修改原始buffer的ID字段，恢复客户端ID
+        *(uint16_t *)(t->buf) = htons(client_ID); // 网络字节序
+
         // 将响应报文发送给原始客户端
-        sendto(servSock, t->buf, t->len, 0,
-               (struct sockaddr *)&original_client_addr, sizeof(original_client_addr));
+        sendPacket(t->sock, t->buf, t->len, &original_client_addr);
 
-        // 直接修改原始buffer的ID字段，恢复客户端ID
-        *(uint16_t *)(t->buf) = htons(client_ID); // 网络字节序        // 将有效的DNS响应添加到缓存
-        if (dnsM.header->rcode == RCODE_NO_ERROR && dnsM.header->ancount > 0 && dnsM.answers)
+        // 将A查询的有效应答添加到缓存
+        int qend = get_question_end(buf, t->len);
+        int rcode = buf[3] & RCODE_MASK;
+        int ancount = (buf[6] << 8) | buf[7];
+        if (qend && rcode == RCODE_NO_ERROR && ancount > 0 && ((buf[qend - 4] << 8) | buf[qend - 3]) == RR_A)
         {
             // 收集所有A记录的IP地址
             uint8_t ip_addresses[10][4]; // 最多支持10个IP地址
@@ -152,35 +156,56 @@ void DNSHandle(Task *t)
             int ip_count = 0;
 
             // 获取上游响应的权威性标识
-            int upstream_authoritative = dnsM.header->aa;
+            int upstream_authoritative = (((buf[2] << 8) | buf[3]) & AA_MASK) != 0;
 
-            DnsResourceRecord *answer = dnsM.answers;
+            DnsRecordIter it;
+            DnsRecordView answer;
+            record_iter_init(&it, buf, t->len, SECTION_ANSWER);
 
             // 遍历所有答案记录
-            while (answer && ip_count < 10)
+            while (ip_count < 10 && record_iter_next(&it, &answer))
             {
-                if (answer->type == QTYPE_A && answer->rdlength == 4)
+                if (answer.type == QTYPE_A && answer.rdlength == 4)
                 {
-                    memcpy(ip_addresses[ip_count], answer->rdata.a_record.ip_addr, 4);
-                    ttl[ip_count] = answer->ttl; // 保存TTL
+                    memcpy(ip_addresses[ip_count], answer.rdata, 4);
+                    ttl[ip_count] = answer.ttl; // 保存TTL
                     ip_count++;
-
-                    debug_print2("Found A record: %s -> %d.%d.%d.%d\n",
-                                 dnsM.questions->qname,
-                                 answer->rdata.a_record.ip_addr[0], answer->rdata.a_record.ip_addr[1],
-                                 answer->rdata.a_record.ip_addr[2], answer->rdata.a_record.ip_addr[3]);
                 }
-
-                answer = answer->next;
             }
 
             // 如果找到了A记录，使用多IP更新缓存，并传递权威性信息
-            if (ip_count > 0)
+            // 缓存键直接取应答里的问题（qname、qtype、qclass），和查询报文中的一致
+            cache_key key;
+            if (ip_count > 0 && cache_key_from_wire(&key, buf + DNS_HEADER_SIZE, qend - 4 - DNS_HEADER_SIZE,
+                                                    RR_A, (buf[qend - 2] << 8) | buf[qend - 1]))
             {
-                update_cache(ip_addresses, ip_count, ttl, dnsM.questions->qname, upstream_authoritative);
+                char qname[MAX_DOMAIN_NAME_LEN] = "";
+                if (debug_mode == 2)
+                {
+                    get_domain(buf + DNS_HEADER_SIZE, qname, buf);
+                }
+                for (int i = 0; i < ip_count; i++)
+                {
+                    debug_print2("Found A record: %s -> %d.%d.%d.%d\n", qname,
+                                 ip_addresses[i][0], ip_addresses[i][1],
+                                 ip_addresses[i][2], ip_addresses[i][3]);
+                }
+
+                // 缓存的IP链表是头插的，倒序传入以保持上游应答中的顺序
+                for (int i = 0, j = ip_count - 1; i < j; i++, j--)
+                {
+                    uint8_t ip[4];
+                    uint32_t tmp = ttl[i];
+                    memcpy(ip, ip_addresses[i], 4);
+                    memcpy(ip_addresses[i], ip_addresses[j], 4);
+                    memcpy(ip_addresses[j], ip, 4);
+                    ttl[i] = ttl[j];
+                    ttl[j] = tmp;
+                }
+                update_cache(ip_addresses, ip_count, ttl, &key, upstream_authoritative);
 
                 debug_print2("Added %d IP(s) to cache for domain: %s (authoritative: %s)\n",
-                             ip_count, dnsM.questions->qname, upstream_authoritative ? "yes" : "no");
+                             ip_count, qname, upstream_authoritative ? "yes" : "no");
             }
         }
 
@@ -202,8 +227,6 @@ void DNSHandle(Task *t)
 
             debug_print2("Released server ID %d\n", server_ID);
         }
-
-        free_message(&dnsM);
         break;
     }
 }
@@ -14,4 +14,11 @@ extern int message_count;
 
 void DNSHandle(Task *t);
 
+// 把命中缓存的单问题A查询（以及被屏蔽域名的AAAA查询）原地改写成应答，返回应答长度
+// 不能直接回答时返回0，报文不变；size为缓冲区可写的最大长度
+int DNSBuildInline(uint8_t *buf, int len, int size);
+
+// 在接收线程上直接回答DNSBuildInline能处理的查询，已回答返回1，其余返回0交给工作线程
+int DNSAnswerInline(Task *t);
+
 #endif
\ No newline at end of file
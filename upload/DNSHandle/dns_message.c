@@ -54,7 +54,73 @@ void set_bits(uint8_t **buffer, int bits, uint32_t value)
     }
 }
 
+// 从消息的arena或堆上分配内存，arena用完时返回NULL
+static void *msg_alloc(DnsMessage *msg, size_t size)
+{
+    if (!msg->arena)
+    {
+        return malloc(size);
+    }
+
+    DnsArena *arena = msg->arena;
+    size_t offset = (arena->used + 7) & ~(size_t)7; // 按8字节对齐
+    if (offset + size > DNS_ARENA_SIZE)
+    {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->data + offset;
+}
+
+// 解析域名并保存到*name，返回域名之后的位置
+// arena模式下直接解析进arena再收缩到实际长度，不经过栈上缓冲区；arena放不下时返回NULL
+static uint8_t *msg_domain(DnsMessage *msg, uint8_t *buffer, uint8_t *start, char **name)
+{
+    if (!msg->arena)
+    {
+        char tmp[MAX_DOMAIN_NAME_LEN] = {0};
+        buffer = get_domain(buffer, tmp, start);
+        *name = malloc(strlen(tmp) + 1);
+        if (*name)
+        {
+            strcpy(*name, tmp);
+        }
+        return buffer;
+    }
+
+    *name = msg_alloc(msg, MAX_DOMAIN_NAME_LEN);
+    if (!*name)
+    {
+        return NULL;
+    }
+    (*name)[0] = '\0';
+    buffer = get_domain(buffer, *name, start);
+    msg->arena->used = (uint8_t *)*name - msg->arena->data + strlen(*name) + 1;
+    return buffer;
+}
+
+// RDATA：arena模式下直接指向报文缓冲区，否则复制一份
+static unsigned char *msg_rdata(DnsMessage *msg, uint8_t *buffer, uint16_t len)
+{
+    if (msg->arena)
+    {
+        return buffer;
+    }
+
+    unsigned char *data = malloc(len);
+    if (data)
+    {
+        memcpy(data, buffer, len);
+    }
+    return data;
+}
+
 void get_message(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
+{
+    get_message_arena(msg, buffer, start, NULL);
+}
+
+void get_message_arena(DnsMessage *msg, uint8_t *buffer, uint8_t *start, DnsArena *arena)
 {
     if (!msg || !buffer || !start)
     {
@@ -62,6 +128,11 @@ void get_message(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     }
 
     // 初始化指针
+    msg->arena = arena;
+    if (arena)
+    {
+        arena->used = 0;
+    }
     msg->header = NULL;
     msg->questions = NULL;
     msg->answers = NULL;
@@ -69,7 +140,7 @@ void get_message(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     msg->additionals = NULL;
 
     // 分配头部空间
-    msg->header = malloc(sizeof(DnsHeader));
+    msg->header = msg_alloc(msg, sizeof(DnsHeader));
     if (!msg->header)
     {
         return;
@@ -104,23 +175,6 @@ void get_message(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     }
 }
 
-uint8_t *set_message(DnsMessage *msg, uint8_t *buffer, uint8_t ip_addrs[][4], int ip_count, int is_authoritative)
-{
-    // debug_print1("%d:  ", message_count++);
-    buffer = set_header(msg, buffer, ip_addrs[0], is_authoritative); // 使用第一个IP作为标识这是响应
-    buffer = set_question(msg, buffer);
-
-    // 为每个IP地址创建答案记录
-    for (int i = 0; i < ip_count; i++)
-    {
-        buffer = set_answer(msg, buffer, ip_addrs[i]);
-    }
-
-    // buffer = set_authority(msg, buffer);
-    // buffer = set_additional(msg, buffer);
-    return buffer;
-}
-
 // 解析DNS头部
 uint8_t *get_header(DnsMessage *msg, uint8_t *buffer)
 {
@@ -156,63 +210,6 @@ uint8_t *get_header(DnsMessage *msg, uint8_t *buffer)
     return ptr;
 }
 
-// 设置DNS头部到缓冲区
-uint8_t *set_header(DnsMessage *msg, uint8_t *buffer, uint8_t *ip_addr, int is_authoritative)
-{
-    if (!msg || !msg->header || !buffer)
-    {
-        return buffer;
-    }
-    uint8_t *ptr = buffer;
-
-    // 设置响应标志（如果这是一个响应）
-    if (ip_addr)
-    {
-        msg->header->qr = 1;                // 设置为响应
-        msg->header->aa = is_authoritative; // 权威应答
-        msg->header->ra = 1;                // 支持递归
-
-        // 检查IP地址是否为0.0.0.0，设置响应码
-        if (ip_addr[0] == 0 && ip_addr[1] == 0 &&
-            ip_addr[2] == 0 && ip_addr[3] == 0)
-        {
-            msg->header->rcode = RCODE_NAME_ERROR;
-            // 对于错误响应，ancount应该为0
-            msg->header->ancount = 0;
-        }
-        else
-        {
-            msg->header->rcode = RCODE_NO_ERROR;
-            // 注意：ancount应该由调用者在调用set_header之前设置好
-            // 不在这里强制修改ancount的值
-        }
-    }
-
-    // 设置ID
-    set_bits(&ptr, 16, msg->header->id);
-
-    // 构建flags字段
-    uint16_t flags = 0;
-    flags |= (msg->header->qr << 15) & QR_MASK;
-    flags |= (msg->header->opcode << 11) & OPCODE_MASK;
-    flags |= (msg->header->aa << 10) & AA_MASK;
-    flags |= (msg->header->tc << 9) & TC_MASK; // 限制最大512字节
-    flags |= (msg->header->rd << 8) & RD_MASK;
-    flags |= (msg->header->ra << 7) & RA_MASK;
-    flags |= (msg->header->z << 4) & Z_MASK;
-    flags |= (msg->header->rcode) & RCODE_MASK;
-
-    set_bits(&ptr, 16, flags);
-
-    // 设置计数字段
-    set_bits(&ptr, 16, msg->header->qdcount);
-    set_bits(&ptr, 16, msg->header->ancount);
-    set_bits(&ptr, 16, msg->header->nscount);
-    set_bits(&ptr, 16, msg->header->arcount);
-
-    return ptr;
-}
-
 // 解析DNS问题部分
 uint8_t *get_question(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 {
@@ -225,22 +222,18 @@ uint8_t *get_question(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 
     for (int i = 0; i < msg->header->qdcount; i++)
     {
-        char name[MAX_DOMAIN_NAME_LEN] = {0};
-        DnsQuestion *question = malloc(sizeof(DnsQuestion));
+        DnsQuestion *question = msg_alloc(msg, sizeof(DnsQuestion));
 
         if (!question)
         {
-            continue; // 内存分配失败，跳过
+            break; // 分配失败，后面的内容无法定位，停止解析
         }
 
-        // 解析域名
-        ptr = get_domain(ptr, name, start);
-
-        // 分配并复制域名
-        question->qname = malloc(strlen(name) + 1);
-        if (question->qname)
+        // 解析并保存域名
+        ptr = msg_domain(msg, ptr, start, &question->qname);
+        if (!ptr)
         {
-            strcpy(question->qname, name);
+            return NULL;
         }
         // debug_print1("%s, TYPE: %d, CLASS: %d\n", question->qname, question->qtype, question->qclass);
 
@@ -256,30 +249,6 @@ uint8_t *get_question(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     return ptr;
 }
 
-// 设置DNS问题部分到缓冲区
-uint8_t *set_question(DnsMessage *msg, uint8_t *buffer)
-{
-    if (!msg || !buffer)
-    {
-        return buffer;
-    }
-
-    uint8_t *ptr = buffer;
-    DnsQuestion *question = msg->questions;
-
-    for (int i = 0; i < msg->header->qdcount && question; i++)
-    {
-        // debug_print1("%s, TYPE: %d, CLASS: %d\n", question->qname, question->qtype, question->qclass);
-        ptr = set_domain(ptr, question->qname);
-        set_bits(&ptr, 16, question->qtype);
-        set_bits(&ptr, 16, question->qclass);
-
-        question = question->next;
-    }
-
-    return ptr;
-}
-
 // 解析DNS答案部分
 uint8_t *get_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 {
@@ -292,22 +261,18 @@ uint8_t *get_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 
     for (int i = 0; i < msg->header->ancount; i++)
     {
-        char name[MAX_DOMAIN_NAME_LEN] = {0};
-        DnsResourceRecord *record = malloc(sizeof(DnsResourceRecord));
+        DnsResourceRecord *record = msg_alloc(msg, sizeof(DnsResourceRecord));
 
         if (!record)
         {
-            continue; // 内存分配失败，跳过
+            break; // 分配失败，后面的记录无法定位，停止解析
         }
 
-        // 解析域名
-        ptr = get_domain(ptr, name, start);
-
-        // 分配并复制域名
-        record->name = malloc(strlen(name) + 1);
-        if (record->name)
+        // 解析并保存域名
+        ptr = msg_domain(msg, ptr, start, &record->name);
+        if (!ptr)
         {
-            strcpy(record->name, name);
+            return NULL;
         }
 
         // 解析记录头部
@@ -328,23 +293,16 @@ uint8_t *get_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
         else if (record->type == QTYPE_CNAME)
         {
             // CNAME记录
-            char cname[MAX_DOMAIN_NAME_LEN] = {0};
-            get_domain(ptr, cname, start);
-            record->rdata.cname_record.name = malloc(strlen(cname) + 1);
-            if (record->rdata.cname_record.name)
+            if (!msg_domain(msg, ptr, start, &record->rdata.cname_record.name))
             {
-                strcpy(record->rdata.cname_record.name, cname);
+                return NULL;
             }
             ptr += record->rdlength;
         }
         else
         {
-            // 其他类型，分配原始数据空间
-            record->rdata.raw_data = malloc(record->rdlength);
-            if (record->rdata.raw_data)
-            {
-                memcpy(record->rdata.raw_data, ptr, record->rdlength);
-            }
+            // 其他类型，保存原始数据
+            record->rdata.raw_data = msg_rdata(msg, ptr, record->rdlength);
             ptr += record->rdlength;
         }
 
@@ -356,35 +314,6 @@ uint8_t *get_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     return ptr;
 }
 
-uint8_t *set_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *ip_addr)
-{
-    if (!msg || !buffer || !ip_addr)
-    {
-        return buffer;
-    }
-
-    uint8_t *ptr = buffer;
-
-    // 使用问题中的域名作为答案域名
-    if (msg->questions && msg->questions->qname)
-    {
-        ptr = set_domain(ptr, msg->questions->qname);
-    }
-
-    set_bits(&ptr, 16, QTYPE_A);   // type: A记录
-    set_bits(&ptr, 16, QCLASS_IN); // class: IN
-    set_bits(&ptr, 32, 300);       // TTL: 300秒
-    set_bits(&ptr, 16, 4);         // rdlength: 4字节
-
-    // 设置IP地址
-    for (int i = 0; i < 4; i++)
-    {
-        set_bits(&ptr, 8, ip_addr[i]);
-    }
-
-    return ptr;
-}
-
 // 解析域名（支持压缩指针）
 uint8_t *get_domain(uint8_t *buffer, char *name, uint8_t *start)
 {
@@ -458,42 +387,6 @@ uint8_t *get_domain(uint8_t *buffer, char *name, uint8_t *start)
     return ptr;
 }
 
-// 设置域名到缓冲区
-uint8_t *set_domain(uint8_t *buffer, char *name)
-{
-    if (!buffer || !name)
-    {
-        return buffer;
-    }
-
-    uint8_t *ptr = buffer;
-    char *name_copy = malloc(strlen(name) + 1);
-    if (!name_copy)
-    {
-        return buffer;
-    }
-
-    strcpy(name_copy, name);
-
-    char *token = strtok(name_copy, ".");
-    while (token != NULL)
-    {
-        uint8_t len = strlen(token);
-        if (len > 63)
-        { // DNS标签最大长度为63
-            len = 63;
-        }
-        *ptr++ = len;
-        memcpy(ptr, token, len);
-        ptr += len;
-        token = strtok(NULL, ".");
-    }
-    *ptr++ = 0; // 结束标记
-
-    free(name_copy);
-    return ptr;
-}
-
 // 释放DNS消息内存
 void free_message(DnsMessage *msg)
 {
@@ -502,6 +395,18 @@ void free_message(DnsMessage *msg)
         return;
     }
 
+    // arena里的内容整块重置即可
+    if (msg->arena)
+    {
+        msg->arena->used = 0;
+        msg->header = NULL;
+        msg->questions = NULL;
+        msg->answers = NULL;
+        msg->authorities = NULL;
+        msg->additionals = NULL;
+        return;
+    }
+
     // 释放头部
     if (msg->header)
     {
@@ -597,21 +502,18 @@ uint8_t *get_authority(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 
     for (int i = 0; i < msg->header->nscount; i++)
     {
-        char name[MAX_DOMAIN_NAME_LEN] = {0};
-        DnsResourceRecord *record = malloc(sizeof(DnsResourceRecord));
+        DnsResourceRecord *record = msg_alloc(msg, sizeof(DnsResourceRecord));
 
         if (!record)
         {
-            continue;
+            break;
         }
 
         // 解析域名
-        ptr = get_domain(ptr, name, start);
-
-        record->name = malloc(strlen(name) + 1);
-        if (record->name)
+        ptr = msg_domain(msg, ptr, start, &record->name);
+        if (!ptr)
         {
-            strcpy(record->name, name);
+            return NULL;
         }
 
         // 解析记录头部
@@ -621,11 +523,7 @@ uint8_t *get_authority(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
         record->rdlength = get_bits(&ptr, 16);
 
         // 对于权威记录，通常直接跳过RDATA或存储为原始数据
-        record->rdata.raw_data = malloc(record->rdlength);
-        if (record->rdata.raw_data)
-        {
-            memcpy(record->rdata.raw_data, ptr, record->rdlength);
-        }
+        record->rdata.raw_data = msg_rdata(msg, ptr, record->rdlength);
         ptr += record->rdlength;
 
         // 添加到链表头部
@@ -648,21 +546,18 @@ uint8_t *get_additional(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
 
     for (int i = 0; i < msg->header->arcount; i++)
     {
-        char name[MAX_DOMAIN_NAME_LEN] = {0};
-        DnsResourceRecord *record = malloc(sizeof(DnsResourceRecord));
+        DnsResourceRecord *record = msg_alloc(msg, sizeof(DnsResourceRecord));
 
         if (!record)
         {
-            continue;
+            break;
         }
 
         // 解析域名
-        ptr = get_domain(ptr, name, start);
-
-        record->name = malloc(strlen(name) + 1);
-        if (record->name)
+        ptr = msg_domain(msg, ptr, start, &record->name);
+        if (!ptr)
         {
-            strcpy(record->name, name);
+            return NULL;
         }
 
         // 解析记录头部
@@ -672,11 +567,7 @@ uint8_t *get_additional(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
         record->rdlength = get_bits(&ptr, 16);
 
         // 对于附加记录，通常直接跳过RDATA或存储为原始数据
-        record->rdata.raw_data = malloc(record->rdlength);
-        if (record->rdata.raw_data)
-        {
-            memcpy(record->rdata.raw_data, ptr, record->rdlength);
-        }
+        record->rdata.raw_data = msg_rdata(msg, ptr, record->rdlength);
         ptr += record->rdlength;
 
         // 添加到链表头部
@@ -685,4 +576,223 @@ uint8_t *get_additional(DnsMessage *msg, uint8_t *buffer, uint8_t *start)
     }
 
     return ptr;
-}
\ No newline at end of file
+}
+
+int check_message(const uint8_t *buffer, int len)
+{
+    if (len < DNS_HEADER_SIZE)
+    {
+        return CHECK_RUNT;
+    }
+
+    int qr = buffer[2] & 0x80;
+    int opcode = (buffer[2] >> 3) & 0x0F;
+    int qdcount = (buffer[4] << 8) | buffer[5];
+    int ancount = (buffer[6] << 8) | buffer[7];
+    int nscount = (buffer[8] << 8) | buffer[9];
+    int arcount = (buffer[10] << 8) | buffer[11];
+
+    // 已定义的opcode只有QUERY、IQUERY、STATUS、NOTIFY、UPDATE；查询报文不应带TC和rcode
+    if (opcode == 3 || opcode > 5 || (!qr && ((buffer[2] & 0x02) || (buffer[3] & 0x0F))))
+    {
+        return CHECK_HEADER;
+    }
+
+    // 问题至少5字节（根域名+type+class），资源记录至少11字节
+    if (qdcount * 5 + (ancount + nscount + arcount) * 11 > len - DNS_HEADER_SIZE)
+    {
+        return CHECK_COUNTS;
+    }
+    // 标准查询只能有一个问题，不带答案和授权记录，附加部分最多OPT和TSIG两条
+    if (!qr && opcode == STANDARD_QUERY && (qdcount != 1 || ancount != 0 || nscount != 0 || arcount > 2))
+    {
+        return CHECK_COUNTS;
+    }
+
+    // 第一个问题的qname：前面没有可指向的名字，不应出现压缩指针；总长不超过255
+    if (qdcount > 0)
+    {
+        int pos = DNS_HEADER_SIZE;
+        while (pos < len && buffer[pos] != 0)
+        {
+            if (buffer[pos] >= 0x40 || pos - DNS_HEADER_SIZE + buffer[pos] + 1 > 254)
+            {
+                return CHECK_QUESTION;
+            }
+            pos += buffer[pos] + 1;
+        }
+        if (pos + 5 > len)
+        {
+            return CHECK_QUESTION;
+        }
+    }
+    return CHECK_OK;
+}
+
+int get_question_end(const uint8_t *buffer, int len)
+{
+    if (len < DNS_HEADER_SIZE || ((buffer[4] << 8) | buffer[5]) != 1)
+    {
+        return 0;
+    }
+    // 跳过qname的各个标签，再加上qtype和qclass
+    int pos = DNS_HEADER_SIZE;
+    while (pos < len && buffer[pos] != 0 && buffer[pos] < 0x40)
+    {
+        pos += buffer[pos] + 1;
+    }
+    if (pos < len && buffer[pos] == 0 && pos + 5 <= len)
+    {
+        return pos + 5;
+    }
+    return 0;
+}
+
+// 跳过pos处的域名，返回域名之后的位置，越界或标签类型不对时返回-1
+static int skip_domain(const uint8_t *buffer, int len, int pos)
+{
+    while (pos < len)
+    {
+        uint8_t c = buffer[pos];
+        if (c == 0)
+        {
+            return pos + 1;
+        }
+        if (c >= 0xC0)
+        {
+            // 压缩指针后面不再有标签
+            return pos + 2 <= len ? pos + 2 : -1;
+        }
+        if (c >= 0x40)
+        {
+            return -1;
+        }
+        pos += c + 1;
+    }
+    return -1;
+}
+
+// 跳过pos处的一条资源记录，返回下一条记录的位置，报文不完整时返回-1
+static int skip_record(const uint8_t *buffer, int len, int pos)
+{
+    pos = skip_domain(buffer, len, pos);
+    if (pos < 0 || pos + 10 > len)
+    {
+        return -1;
+    }
+    pos += 10 + ((buffer[pos + 8] << 8) | buffer[pos + 9]);
+    return pos <= len ? pos : -1;
+}
+
+int record_iter_init(DnsRecordIter *it, const uint8_t *buffer, int len, int section)
+{
+    it->buffer = buffer;
+    it->len = len;
+    it->pos = DNS_HEADER_SIZE;
+    it->remaining = 0;
+    if (len < DNS_HEADER_SIZE || section < SECTION_ANSWER || section > SECTION_ADDITIONAL)
+    {
+        return 0;
+    }
+
+    // 跳过问题部分
+    int qdcount = (buffer[4] << 8) | buffer[5];
+    for (int i = 0; i < qdcount; i++)
+    {
+        it->pos = skip_domain(buffer, len, it->pos);
+        if (it->pos < 0 || it->pos + 4 > len)
+        {
+            return 0;
+        }
+        it->pos += 4;
+    }
+
+    // 跳过目标部分之前的各部分，计数依次在头部偏移6、8、10处
+    for (int s = SECTION_ANSWER; s < section; s++)
+    {
+        int count = (buffer[6 + s * 2] << 8) | buffer[7 + s * 2];
+        for (int i = 0; i < count; i++)
+        {
+            it->pos = skip_record(buffer, len, it->pos);
+            if (it->pos < 0)
+            {
+                return 0;
+            }
+        }
+    }
+
+    it->remaining = (buffer[6 + section * 2] << 8) | buffer[7 + section * 2];
+    return 1;
+}
+
+int record_iter_next(DnsRecordIter *it, DnsRecordView *rr)
+{
+    if (it->remaining <= 0)
+    {
+        return 0;
+    }
+
+    const uint8_t *buffer = it->buffer;
+    int pos = skip_domain(buffer, it->len, it->pos);
+    if (pos < 0 || pos + 10 > it->len)
+    {
+        it->remaining = 0;
+        return 0;
+    }
+
+    rr->name = buffer + it->pos;
+    rr->type = (buffer[pos] << 8) | buffer[pos + 1];
+    rr->class_code = (buffer[pos + 2] << 8) | buffer[pos + 3];
+    rr->ttl = ((uint32_t)buffer[pos + 4] << 24) | ((uint32_t)buffer[pos + 5] << 16) |
+              ((uint32_t)buffer[pos + 6] << 8) | buffer[pos + 7];
+    rr->rdlength = (buffer[pos + 8] << 8) | buffer[pos + 9];
+    rr->rdata = buffer + pos + 10;
+    if (pos + 10 + rr->rdlength > it->len)
+    {
+        it->remaining = 0;
+        return 0;
+    }
+
+    it->pos = pos + 10 + rr->rdlength;
+    it->remaining--;
+    return 1;
+}
+
+int set_error_response(uint8_t *buffer, int len, int rcode)
+{
+    if (len < DNS_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    // 只保留一个问题
+    int end = get_question_end(buffer, len);
+
+    // QR置1，保留opcode和RD，清掉AA、TC；RA置1并写入rcode
+    buffer[2] = (uint8_t)(0x80 | (buffer[2] & 0x79));
+    buffer[3] = (uint8_t)(0x80 | (rcode & 0x0F));
+    buffer[4] = 0;
+    buffer[5] = end > 0 ? 1 : 0;
+    memset(buffer + 6, 0, 6); // ancount、nscount、arcount
+    return end > 0 ? end : DNS_HEADER_SIZE;
+}
+
+void set_a_record(uint8_t *buffer, const uint8_t ip[4], uint32_t ttl)
+{
+    set_bits(&buffer, 16, 0xC000 | DNS_HEADER_SIZE);
+    set_bits(&buffer, 16, QTYPE_A);
+    set_bits(&buffer, 16, QCLASS_IN);
+    set_bits(&buffer, 32, ttl);
+    set_bits(&buffer, 16, 4);
+    memcpy(buffer, ip, 4);
+}
+
+void set_response_flags(uint8_t *buffer, int ancount, int rcode, int is_authoritative, int tc)
+{
+    buffer[2] = (uint8_t)(0x80 | (buffer[2] & 0x79) | (is_authoritative ? 0x04 : 0) | (tc ? 0x02 : 0));
+    buffer[3] = (uint8_t)(0x80 | (rcode & 0x0F));
+    buffer[6] = (uint8_t)(ancount >> 8);
+    buffer[7] = (uint8_t)ancount;
+    memset(buffer + 8, 0, 4); // nscount、arcount
+}
+
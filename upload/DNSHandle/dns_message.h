@@ -16,6 +16,8 @@ extern int message_count;
 // Maximum number of RRs of a certain type (e.g. answers)
 #define MAX_RRS 10
 // Maximum size for general buffers
+// 解析区大小，512字节报文最坏情况下的全部记录和展开后的域名都能放下
+#define DNS_ARENA_SIZE 16384
 
 // DNS Class codes
 // typedef enum
@@ -105,9 +107,17 @@ typedef struct DnsResourceRecord
     struct DnsResourceRecord *next; // For linked list support
 } DnsResourceRecord;
 
+// 解析用的线性分配区：头部、记录、域名顺序分配，处理完一个报文整块重置，不逐个free
+typedef struct
+{
+    size_t used;
+    uint8_t data[DNS_ARENA_SIZE];
+} DnsArena;
+
 // DNS Message Structure (to hold all parts of a DNS message)
 typedef struct
 {
+    DnsArena *arena; // 非NULL时各部分分配在arena里，raw_data直接指向报文缓冲区
     DnsHeader *header;
     DnsQuestion *questions;         // Linked list of questions
     DnsResourceRecord *answers;     // Linked list of answer records
@@ -148,28 +158,87 @@ void set_bits(uint8_t **buffer, int bits, uint32_t value); // 参数类型应该
 
 void get_message(DnsMessage *msg, uint8_t *buffer, uint8_t *start);
 
-uint8_t *set_message(DnsMessage *msg, uint8_t *buffer, uint8_t ip_addrs[][4], int ip_count, int is_authoritative);
+// 与get_message相同，但全部解析结果放在arena里（先重置arena），不调用malloc
+// arena放不下时剩余的记录不再解析；结果只在报文缓冲区和arena都未被复用前有效
+void get_message_arena(DnsMessage *msg, uint8_t *buffer, uint8_t *start, DnsArena *arena);
 
 uint8_t *get_header(DnsMessage *msg, uint8_t *buffer);
 
-uint8_t *set_header(DnsMessage *msg, uint8_t *buffer, uint8_t *ip_addr, int is_authoritative);
-
 uint8_t *get_question(DnsMessage *msg, uint8_t *buffer, uint8_t *start);
 
-uint8_t *set_question(DnsMessage *msg, uint8_t *buffer);
-
 uint8_t *get_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *start);
 
-uint8_t *set_answer(DnsMessage *msg, uint8_t *buffer, uint8_t *ip_addr);
-
 uint8_t *get_authority(DnsMessage *msg, uint8_t *buffer, uint8_t *start);
 
 uint8_t *get_additional(DnsMessage *msg, uint8_t *buffer, uint8_t *start);
 
 uint8_t *get_domain(uint8_t *buffer, char *name, uint8_t *start);
 
-uint8_t *set_domain(uint8_t *buffer, char *name);
-
 void free_message(DnsMessage *msg);
 
+// 把查询报文原地改写为只带原问题的错误应答（如SERVFAIL、REFUSED），返回应答长度
+// 问题部分不完整时去掉问题只回头部，报文连头部都不完整时返回0
+int set_error_response(uint8_t *buffer, int len, int rcode);
+
+// 入口检查的拒绝原因
+typedef enum
+{
+    CHECK_OK = 0,
+    CHECK_RUNT,     // 不够一个头部
+    CHECK_HEADER,   // opcode未定义，或查询报文带了TC、rcode
+    CHECK_COUNTS,   // 各部分计数和报文长度对不上，或查询报文带了答案/授权记录
+    CHECK_QUESTION, // 问题部分的标签结构不对
+    CHECK_REASONS
+} CheckResult;
+
+// 入队前的快速检查，不分配内存，只看头部和问题部分，返回CheckResult
+int check_message(const uint8_t *buffer, int len);
+
+// 报文只有一个问题且格式完整时返回问题部分结束的位置，否则返回0
+int get_question_end(const uint8_t *buffer, int len);
+
+// 一条名字为压缩指针（指向问题qname）的A记录的长度
+#define DNS_A_RECORD_SIZE 16
+
+// 在buffer处写一条名字为0xC00C的A记录，共DNS_A_RECORD_SIZE字节
+void set_a_record(uint8_t *buffer, const uint8_t ip[4], uint32_t ttl);
+
+// 答案部分（ancount条）已经写在问题之后时，把查询报文的头部改成应答：QR、AA、TC、RA和rcode，
+// 保留opcode和RD，去掉授权和附加部分的计数
+void set_response_flags(uint8_t *buffer, int ancount, int rcode, int is_authoritative, int tc);
+
+// 资源记录所在的部分
+typedef enum
+{
+    SECTION_ANSWER = 0,
+    SECTION_AUTHORITY,
+    SECTION_ADDITIONAL
+} DnsSection;
+
+// 资源记录的只读视图，数值字段已转为主机字节序，name和rdata指向报文缓冲区
+typedef struct
+{
+    const uint8_t *name; // 记录名在报文中的位置（可能是压缩指针），需要时再用get_domain展开
+    uint16_t type;
+    uint16_t class_code;
+    uint32_t ttl;
+    uint16_t rdlength;
+    const uint8_t *rdata;
+} DnsRecordView;
+
+// 资源记录迭代器，每次只解码下一条记录的固定字段，不分配内存
+typedef struct
+{
+    const uint8_t *buffer;
+    int len;
+    int pos;       // 下一条记录的位置
+    int remaining; // 当前部分还没取出的记录数
+} DnsRecordIter;
+
+// 定位到section部分的第一条记录，前面的问题和记录只跳过不解码；报文不完整时返回0
+int record_iter_init(DnsRecordIter *it, const uint8_t *buffer, int len, int section);
+
+// 取出当前部分的下一条记录，部分结束或报文不完整时返回0
+int record_iter_next(DnsRecordIter *it, DnsRecordView *rr);
+
 #endif // DNS_MESSAGE_H
\ No newline at end of file
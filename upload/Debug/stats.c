@@ -0,0 +1,155 @@
+#include "stats.h"
+#include "multiThread.h"
+#include "xdpPath.h"
+
+relay_stats stats;
+int stats_interval = 0;
+
+void stats_add(volatile long *counter, long value)
+{
+    my_atomicAdd(counter, value);
+}
+
+void stats_delay(long us)
+{
+    my_atomicAdd(&stats.delay_samples, 1);
+    my_atomicAdd(&stats.delay_sum_us, us);
+    long max = stats.delay_max_us;
+    while (us > max)
+    {
+        long cur = my_atomicCas(&stats.delay_max_us, max, us);
+        if (cur == max)
+        {
+            break;
+        }
+        max = cur;
+    }
+}
+
+void print_stats()
+{
+    long calls = stats.recv_calls;
+    long packets = stats.recv_packets;
+    long sendCalls = stats.send_calls;
+    long sendPackets = stats.send_packets;
+
+    if (process_index >= 0)
+    {
+        printf("\n=== Relay Statistics (process %d) ===\n", process_index);
+    }
+    else
+    {
+        printf("\n=== Relay Statistics ===\n");
+    }
+    printf("Ingress: %ld packet(s) in %ld call(s), avg batch fill: %.2f/%d\n",
+           packets, calls, calls > 0 ? (double)packets / calls : 0.0, recv_batch);
+    printf("Egress: %ld packet(s) in %ld call(s), avg batch fill: %.2f/%d\n",
+           sendPackets, sendCalls, sendCalls > 0 ? (double)sendPackets / sendCalls : 0.0, send_batch);
+    if (stats.loop_wakeups > 0)
+    {
+        printf("Event loop: %ld wakeup(s), %.2f packet(s) per wakeup\n",
+               stats.loop_wakeups, (double)packets / stats.loop_wakeups);
+    }
+    if (stats.uring_enters > 0)
+    {
+        printf("io_uring: %ld enter(s), %.2f packet(s) per enter\n",
+               stats.uring_enters, (double)(packets + sendPackets) / stats.uring_enters);
+    }
+    if (shard_count > 1)
+    {
+        printf("Shard sockets (packets):");
+        for (int i = 0; i < shard_count; i++)
+        {
+            printf(" %ld", shardPackets(i));
+        }
+        printf("%s\n", qname_steer ? " (steered by qname)" : "");
+    }
+    if (xdp_interface)
+    {
+        printf("AF_XDP on %s queue %d: %ld packet(s), %ld answered in UMEM\n", xdp_interface, xdp_queue,
+               stats.xdp_packets, stats.xdp_answers);
+    }
+    if (inline_handler)
+    {
+        printf("Inline cache hits: %ld (%.1f%% of received)\n", stats.inline_hits,
+               packets > 0 ? 100.0 * stats.inline_hits / packets : 0.0);
+    }
+    if (worker_count > 0)
+    {
+        // 每个工作线程：队列深度/偷到的任务数，用于观察负载是否均衡
+        long steals = 0;
+        printf("Worker queues (depth/stolen):");
+        for (int i = 0; i < worker_count && i < MAX_WORKERS; i++)
+        {
+            printf(" %d/%ld", workerQueueDepth(i), workerSteals(i));
+            steals += workerSteals(i);
+        }
+        printf("\nTask queue: %ld worker park(s), %ld steal(s), %s dispatch\n",
+               stats.worker_parks, steals, flow_hash ? "flow-hash" : "round-robin");
+        printf("Worker pool: %ld active of %ld started (bounds %d-%d), util %d%%, %ld grow(s), %ld shrink(s)\n",
+               pool_size, worker_count, pool_min, pool_max, pool_util, stats.pool_grows, stats.pool_shrinks);
+        if (priority_weight > 0)
+        {
+            printf("Lanes: %ld high, %ld low (weight %d)\n", stats.lane_high, stats.lane_low, priority_weight);
+        }
+        if (fair_queue)
+        {
+            // 只列出有排队或有丢弃的桶：桶号:排队数/丢弃数
+            printf("Fair queue: %ld queued, %ld dropped; buckets:", fqBacklogSize(), stats.fq_drops);
+            for (int i = 0; i < FQ_BUCKETS; i++)
+            {
+                if (fqBucketDepth(i) > 0 || fqBucketDrops(i) > 0)
+                {
+                    printf(" %d:%d/%ld", i, fqBucketDepth(i), fqBucketDrops(i));
+                }
+            }
+            printf("\n");
+        }
+        if (spin_us > 0)
+        {
+            printf("Idle wait: %ld spin hit(s) vs %ld park(s), %.1f ms spent spinning (window %u us)\n",
+                   stats.spin_hits, stats.worker_parks, stats.spin_us / 1000.0, spin_us);
+        }
+    }
+    long samples = stats.delay_samples;
+    if (samples > 0)
+    {
+        long sum = stats.delay_sum_us;
+        long max = stats.delay_max_us;
+        // 减去读到的值而不是直接清零，读完之后新记的样本留到下个周期
+        my_atomicAdd(&stats.delay_samples, -samples);
+        my_atomicAdd(&stats.delay_sum_us, -sum);
+        my_atomicCas(&stats.delay_max_us, max, 0);
+        printf("Queue delay: avg %.1f us, max %ld us over %ld task(s)\n", (double)sum / samples, max, samples);
+    }
+    if (stats.shed_aqm > 0 || stats.shed_overflow > 0)
+    {
+        printf("Shed: %ld by AQM (%s), %ld on full queues\n", stats.shed_aqm,
+               shed_rcode < 0 ? "dropped" : shed_rcode == RCODE_REFUSED ? "REFUSED" : "SERVFAIL",
+               stats.shed_overflow);
+    }
+    long rejects = stats.reject_runt + stats.reject_header + stats.reject_counts + stats.reject_question;
+    if (rejects > 0)
+    {
+        printf("Prefilter: %ld rejected (%s): %ld runt, %ld header, %ld count(s), %ld question\n", rejects,
+               reject_rcode < 0 ? "dropped" : "FORMERR", stats.reject_runt, stats.reject_header,
+               stats.reject_counts, stats.reject_question);
+    }
+    if (stats.pool_fallbacks > 0)
+    {
+        printf("Packet pool: %ld fallback allocation(s)\n", stats.pool_fallbacks);
+    }
+    printf("========================\n\n");
+}
+
+void *statsThread(void *lpParam)
+{
+    (void)lpParam;
+
+    while (1)
+    {
+        my_sleep(stats_interval * 1000);
+        print_stats();
+    }
+    return NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "header.h"
+#include "platformThread.h"
+
+// 运行统计计数，各线程通过stats_add原子累加
+typedef struct
+{
+    volatile long recv_calls;   // 接收系统调用次数
+    volatile long recv_packets; // 接收到的报文总数
+    volatile long send_calls;   // 发送系统调用次数
+    volatile long send_packets; // 发送的报文总数
+    volatile long loop_wakeups; // 事件循环被唤醒的次数
+    volatile long uring_enters; // io_uring_enter调用次数（收发合并提交）
+    volatile long pool_fallbacks; // 缓冲池用完后临时malloc的次数
+    volatile long worker_parks;   // 工作线程因任务队列空而挂起的次数
+    volatile long spin_hits;      // 工作线程在自旋期间就等到任务的次数
+    volatile long spin_us;        // 工作线程自旋等待累计的微秒数
+    volatile long shed_aqm;       // 排队过久被队列管理丢弃或回错误的查询数
+    volatile long shed_overflow;  // 所有队列都满时接收线程直接丢弃的查询数
+    volatile long lane_high;      // 分到高优先级通道的任务数
+    volatile long lane_low;       // 分到低优先级通道的任务数
+    volatile long fq_drops;       // 公平队列桶满丢弃的查询数
+    volatile long pool_grows;     // 线程池扩容次数
+    volatile long pool_shrinks;   // 线程池缩容次数
+    volatile long inline_hits;    // 接收线程直接回答的缓存命中数
+    volatile long reject_runt;    // 入口检查拒绝的报文，按原因分类，见check_message
+    volatile long reject_header;
+    volatile long reject_counts;
+    volatile long reject_question;
+    volatile long xdp_packets;    // AF_XDP通道收到的报文数
+    volatile long xdp_answers;    // 在UMEM帧里直接回答的报文数
+    volatile long delay_samples;  // 以下三项是本统计周期内任务的排队时间，打印后清零
+    volatile long delay_sum_us;
+    volatile long delay_max_us;
+} relay_stats;
+
+extern relay_stats stats;
+extern int stats_interval; // 统计输出间隔（秒），0表示不输出
+
+void stats_add(volatile long *counter, long value);
+// 记录一个任务的排队时间
+void stats_delay(long us);
+void print_stats();
+
+// 统计线程，每隔stats_interval秒打印一次统计信息
+void *statsThread(void *lpParam);
+
+#endif
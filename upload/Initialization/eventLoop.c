@@ -0,0 +1,203 @@
+#include "eventLoop.h"
+#include <errno.h>
+
+int event_loops = 0;
+int use_uring = 0;
+
+// 用poll监听客户端socket和上游socket，成功返回0
+static int initPoller(EventLoop *loop)
+{
+    loop->poller = my_createPoller();
+    if (!loop->poller)
+    {
+        return -1;
+    }
+
+    if (my_setNonBlocking(loop->clientSock) != 0 || my_setNonBlocking(loop->upstreamSock) != 0)
+    {
+        return -1;
+    }
+    if (my_pollerAdd(loop->poller, loop->clientSock) != 0 ||
+        my_pollerAdd(loop->poller, loop->upstreamSock) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int initEventLoop(EventLoop *loop, my_socket clientSock, void (*handler)(Task *))
+{
+    loop->clientSock = clientSock;
+    loop->handler = handler;
+    loop->upstreamSock = MY_INVALID_SOCKET;
+    loop->upstreamAddr = &remoteSockAddr;
+    loop->uring = NULL;
+
+    if (connect_upstream)
+    {
+        loop->upstreamSock = openUpstreamSocket();
+        loop->upstreamAddr = NULL;
+    }
+    if (loop->upstreamSock == MY_INVALID_SOCKET)
+    {
+        loop->upstreamSock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        loop->upstreamAddr = &remoteSockAddr;
+    }
+
+    if (use_uring)
+    {
+        // 内核不支持multishot recvmsg（6.0之前）时接收请求提交后立即失败
+        loop->uring = my_createUring(URING_ENTRIES, URING_BUFFERS, SIZE);
+        if (loop->uring &&
+            my_uringRecv(loop->uring, loop->clientSock, 0) == 0 &&
+            my_uringRecv(loop->uring, loop->upstreamSock, 1) == 0 &&
+            my_uringCheckRecv(loop->uring) == 0)
+        {
+            return 0;
+        }
+        printf("io_uring is not available, using poll instead.\n");
+        my_destroyUring(loop->uring);
+        loop->uring = NULL;
+        use_uring = 0;
+    }
+
+    return initPoller(loop);
+}
+
+// 把socket上已经到达的报文收完（最多LOOP_DRAIN_ROUNDS批）并逐个处理
+static void drainSocket(EventLoop *loop, my_socket s, Task *batch, my_packet *pkts)
+{
+    for (int round = 0; round < LOOP_DRAIN_ROUNDS; round++)
+    {
+        int n = my_recvBatch(s, pkts, recv_batch);
+        if (n <= 0)
+        {
+            if (n < 0 && !my_socketWouldBlock())
+            {
+                perror("recvfrom");
+            }
+            return;
+        }
+        stats_add(&stats.recv_calls, 1);
+        stats_add(&stats.recv_packets, n);
+        if (s == loop->clientSock)
+        {
+            countShardPackets(loop->index, n);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            Task *t = &batch[i];
+            t->len = pkts[i].len;
+            t->clientAddrLen = sizeof(t->clientAddr);
+            t->sock = loop->clientSock;
+            t->upstreamSock = loop->upstreamSock;
+            t->upstreamAddr = loop->upstreamAddr;
+            debug_print2("Receive %d bytes from %s:%d\n", t->len,
+                         inet_ntoa(t->clientAddr.sin_addr), ntohs(t->clientAddr.sin_port));
+            debug_dns_message_hex((unsigned char *)t->buf, t->len);
+
+            if (!rejectTask(t))
+            {
+                loop->handler(t);
+            }
+        }
+        if (n < recv_batch)
+        {
+            return; // 已经收空
+        }
+    }
+}
+
+// io_uring收到报文的回调，tag 0为客户端socket，1为上游socket
+static void onUringPacket(void *arg, int tag, char *buf, int len, struct sockaddr_in *addr)
+{
+    EventLoop *loop = (EventLoop *)arg;
+    Task t;
+
+    // 直接在io_uring的接收缓冲区上处理，回调返回后缓冲区才还给内核
+    t.buf = buf;
+    t.pkt = NULL;
+    t.len = len;
+    t.clientAddr = *addr;
+    t.clientAddrLen = sizeof(t.clientAddr);
+    t.sock = loop->clientSock;
+    t.upstreamSock = loop->upstreamSock;
+    t.upstreamAddr = loop->upstreamAddr;
+    stats_add(&stats.recv_packets, 1);
+    if (tag == 0)
+    {
+        countShardPackets(loop->index, 1);
+    }
+    debug_print2("Receive %d bytes from %s:%d\n", t.len,
+                 inet_ntoa(t.clientAddr.sin_addr), ntohs(t.clientAddr.sin_port));
+    debug_dns_message_hex((unsigned char *)t.buf, t.len);
+
+    if (!rejectTask(&t))
+    {
+        loop->handler(&t);
+    }
+}
+
+// io_uring事件循环，接收请求出现无法恢复的错误时改用poll并返回
+static void uringLoop(EventLoop *loop)
+{
+    // 本线程的回包排进io_uring，在下一次等待时随接收请求一起提交
+    setSendUring(loop->uring);
+    for (;;)
+    {
+        if (my_uringWait(loop->uring, onUringPacket, loop) < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+            perror("io_uring");
+            break;
+        }
+        stats_add(&stats.uring_enters, 1);
+    }
+
+    printf("io_uring event loop %d failed, using poll instead.\n", loop->index);
+    setSendUring(NULL);
+    my_destroyUring(loop->uring);
+    loop->uring = NULL;
+    if (initPoller(loop) != 0)
+    {
+        printf("Error: Failed to create poller for event loop %d.\n", loop->index);
+        exit(1);
+    }
+}
+
+void *eventLoopThread(void *lpParam)
+{
+    EventLoop *loop = (EventLoop *)lpParam;
+    bindReceiver(loop->index);
+    if (loop->uring)
+    {
+        uringLoop(loop);
+    }
+
+    my_packet pkts[MY_MAX_BATCH];
+    Task *batch = allocTaskBatch(pkts, recv_batch);
+    my_socket ready[2];
+
+    for (;;)
+    {
+        int n = my_pollerWait(loop->poller, ready, 2, -1);
+        if (n < 0)
+        {
+            perror("poll");
+            continue;
+        }
+        stats_add(&stats.loop_wakeups, 1);
+
+        for (int i = 0; i < n; i++)
+        {
+            drainSocket(loop, ready[i], batch, pkts);
+        }
+        // 一轮事件处理完，把攒着的回包发出去
+        flushPackets();
+    }
+    return NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include "multiThread.h"
+#include "platformEvent.h"
+#include "platformUring.h"
+
+// io_uring每个事件循环的SQ深度和接收缓冲区个数
+#define URING_ENTRIES 256
+#define URING_BUFFERS 1024
+
+// 每次可读事件最多连续收几批，防止一个socket饿死同一循环里的其他socket
+#define LOOP_DRAIN_ROUNDS 8
+
+// 事件循环，一个线程一个，非阻塞地同时监听面向客户端的socket和自己的上游socket
+typedef struct
+{
+    my_socket clientSock;   // 接收客户端查询、向客户端回包
+    my_socket upstreamSock; // 本循环专用的上游socket，转发和上游应答都走这里
+    struct sockaddr_in *upstreamAddr; // upstreamSock已connect时为NULL
+    void (*handler)(Task *);
+    my_poller *poller;
+    my_uring *uring; // 使用io_uring引擎时非空，此时不使用poller
+    int index;       // 循环序号，决定绑定到接收CPU集合中的哪一个
+} EventLoop;
+
+extern int event_loops; // 事件循环线程数，0表示不使用事件循环
+extern int use_uring;   // 事件循环是否使用io_uring引擎
+
+// 初始化事件循环，创建上游socket并注册到poller，成功返回0
+int initEventLoop(EventLoop *loop, my_socket clientSock, void (*handler)(Task *));
+
+// 事件循环线程，参数为EventLoop*，不返回
+void *eventLoopThread(void *lpParam);
+
+#endif
@@ -1,60 +1,1086 @@
 #include "multiThread.h"
 #include "platformSocket.h"
+#include "dns_message.h"
+#include "data_struct.h"
+#include "taskRing.h"
 
-my_mutex *queueMutex;
 my_mutex *ID_list_Mutex;
 my_mutex *log_Mutex;
 my_mutex *hash_table_Mutex;
-my_semaphore *queueNotEmpty;
-my_semaphore *queueNotFull;
-int taskHead = 0, taskTail = 0;  // 全局变量，因为需要多线程共享
-Task taskQueue[TASK_QUEUE_SIZE]; // 全局变量，因为需要多线程共享
+int recv_batch = 1;
+int send_batch = 1;
+int shard_count = 0;
+int process_count = 0;
+int process_index = -1;
+int qname_steer = 0;
+static volatile long shardRecv[MAX_SHARDS];
+int connect_upstream = 0;
+int flow_hash = 0;
+unsigned int spin_us = 0;
+unsigned int aqm_target_us = 0;
+unsigned int aqm_interval_us = 100000;
+int shed_rcode = RCODE_SERVER_FAILURE;
+int priority_weight = 4;
+int fair_queue = 0;
+int (*inline_handler)(Task *) = NULL;
+int prefilter = 1;
+int reject_rcode = -1;
+volatile long worker_count = 0;
+volatile long pool_size = 0;
+int pool_min = 0;
+int pool_max = 0;
+int pool_util = 0;
+static void (*workerHandler)(Task *) = NULL;
+
+// 每个工作线程私有的发送批次
+typedef struct
+{
+    my_socket sock; // 批次内报文共用的socket
+    int count;
+    char bufs[MY_MAX_BATCH][SIZE];
+    struct sockaddr_in addrs[MY_MAX_BATCH];
+    my_packet pkts[MY_MAX_BATCH];
+} SendBatch;
+
+static my_thread_local SendBatch *localBatch = NULL;
+static my_thread_local my_uring *localUring = NULL;
+
+// 本线程独占的已连接上游socket，以及从它发出、还没收到应答的查询数
+static my_thread_local my_socket localUpstream = MY_INVALID_SOCKET;
+static my_thread_local int localPending = 0;
+static my_thread_local time_t localLastForward = 0;
+
+// 高优先级通道放上游应答和可能命中缓存的查询，低优先级通道放需要转发的查询
+#define LANE_HIGH 0
+#define LANE_LOW 1
+#define LANE_COUNT 2
+
+// 每个工作线程一组任务队列（每个优先级一条），接收线程往里投递，队列主人和偷任务的线程从里面取
+typedef struct
+{
+    TaskRing lanes[LANE_COUNT];
+    my_eventcount ready;     // 本线程无事可做时在此等待
+    my_semaphore *doorbell;  // -cu模式下代替ready唤醒，可以和上游socket一起等待
+    volatile long steals;    // 从别的线程队列偷到的任务数
+    // 以下三项只由本线程写，线程池调整线程读取差值估算忙碌比例和排队时间
+    volatile unsigned long long busyNs;
+    volatile unsigned long long delayUs;
+    volatile unsigned long long tasks;
+    int index;
+    char pad[CACHE_LINE];    // 与下一个工作线程的入队位置隔开
+} Worker;
+
+// 由各工作线程在绑核后自己分配，队列内存落在该线程所在的NUMA节点上
+static Worker *workers[MAX_WORKERS];
+static volatile long workerSeq = 0;
+static my_eventcount slotFree; // 所有队列都满时接收线程在此等待
+static my_thread_local unsigned int nextWorker = 0;
+static my_thread_local int highStreak = 0; // 连续从高优先级通道取出的任务数
+static volatile long fqBacklog = 0; // 公平队列中的任务总数，不为0时新查询也排进公平队列，保证先来后到
+
+static int workerDepth(Worker *w)
+{
+    return ringDepth(&w->lanes[LANE_HIGH]) + ringDepth(&w->lanes[LANE_LOW]);
+}
+
+int workerQueueDepth(int i)
+{
+    return workers[i] ? workerDepth(workers[i]) : 0;
+}
+
+long workerSteals(int i)
+{
+    return workers[i] ? workers[i]->steals : 0;
+}
+
+// 唤醒在等的工作线程，它没在等时返回0
+static int notifyWorker(Worker *w)
+{
+    if (!w->doorbell)
+    {
+        return my_notifyEvent(&w->ready, 1);
+    }
+    // 加0是为了要一次全屏障，与等待方的登记配对
+    if (my_atomicAdd(&w->ready.waiters, 0) == 0)
+    {
+        return 0;
+    }
+    my_postSemaphore(w->doorbell);
+    return 1;
+}
+
+// 任务放进了第i个队列；队列主人正忙而任务开始积压时，另叫醒一个空闲线程来偷
+static void wakeWorkers(int i)
+{
+    if (notifyWorker(workers[i]) || (workerDepth(workers[i]) <= 1 && fqBacklog <= 1))
+    {
+        return;
+    }
+    long n = my_atomicLoad(&pool_size);
+    for (int k = 1; k < n; k++)
+    {
+        Worker *w = workers[(i + k) % n];
+        if (w->ready.waiters > 0 && notifyWorker(w))
+        {
+            return;
+        }
+    }
+}
+
+static unsigned int clientHash(Task *t)
+{
+    unsigned int h = (unsigned int)t->clientAddr.sin_addr.s_addr ^ ((unsigned int)t->clientAddr.sin_port << 16);
+    return (h * 2654435761u) >> 16;
+}
+
+// 选择投递的队列：默认轮转；-fh按客户端地址哈希，同一客户端的查询落在同一线程
+static int pickWorker(Task *t)
+{
+    long n = my_atomicLoad(&pool_size);
+    if (flow_hash)
+    {
+        return (int)(clientHash(t) % n);
+    }
+    return (int)(nextWorker++ % n);
+}
+
+// 按客户端地址分桶的公平队列，工作线程队列排满后查询先进这里，再按赤字轮转（DRR）交给工作线程
+// 桶内FIFO，活跃桶串成链表；赤字以字节计，大报文消耗更多配额
+typedef struct
+{
+    Task tasks[FQ_BUCKET_DEPTH];
+    int head;
+    int count;
+    int deficit;
+    int active; // 是否在活跃链表中
+    int next;   // 活跃链表中的下一个桶，-1表示结尾
+    volatile long drops; // 桶满被丢弃的查询数
+} FqBucket;
+
+static FqBucket fqBuckets[FQ_BUCKETS];
+static int fqActiveHead = -1;
+static int fqActiveTail = -1;
+static my_mutex *fqMutex;
+
+static void fqActivate(int b)
+{
+    fqBuckets[b].active = 1;
+    fqBuckets[b].next = -1;
+    if (fqActiveTail < 0)
+    {
+        fqActiveHead = b;
+    }
+    else
+    {
+        fqBuckets[fqActiveTail].next = b;
+    }
+    fqActiveTail = b;
+}
+
+static int fqPopActive()
+{
+    int b = fqActiveHead;
+    fqActiveHead = fqBuckets[b].next;
+    if (fqActiveHead < 0)
+    {
+        fqActiveTail = -1;
+    }
+    fqBuckets[b].active = 0;
+    return b;
+}
+
+// 放入客户端对应的桶，桶满时丢弃并返回0
+static int fqEnqueue(Task *t)
+{
+    int b = (int)(clientHash(t) % FQ_BUCKETS);
+    FqBucket *q = &fqBuckets[b];
+    my_lockMutex(fqMutex);
+    if (q->count == FQ_BUCKET_DEPTH)
+    {
+        q->drops++;
+        my_unlockMutex(fqMutex);
+        stats_add(&stats.fq_drops, 1);
+        freePacket(t->pkt);
+        return 0;
+    }
+    q->tasks[(q->head + q->count) % FQ_BUCKET_DEPTH] = *t;
+    q->count++;
+    if (!q->active)
+    {
+        q->deficit = 0;
+        fqActivate(b);
+    }
+    my_atomicAdd(&fqBacklog, 1);
+    my_unlockMutex(fqMutex);
+    return 1;
+}
+
+// 赤字轮转：队头桶的赤字不够发队头报文时补一个配额并移到队尾
+static int fqDequeue(Task *t)
+{
+    my_lockMutex(fqMutex);
+    while (fqActiveHead >= 0)
+    {
+        FqBucket *q = &fqBuckets[fqActiveHead];
+        Task *head = &q->tasks[q->head];
+        if (q->deficit < head->len)
+        {
+            q->deficit += FQ_QUANTUM;
+            fqActivate(fqPopActive());
+            continue;
+        }
+        *t = *head;
+        q->deficit -= head->len;
+        q->head = (q->head + 1) % FQ_BUCKET_DEPTH;
+        q->count--;
+        if (q->count == 0)
+        {
+            fqPopActive();
+        }
+        my_atomicAdd(&fqBacklog, -1);
+        my_unlockMutex(fqMutex);
+        return 1;
+    }
+    my_unlockMutex(fqMutex);
+    return 0;
+}
+
+int fqBucketDepth(int i)
+{
+    return fqBuckets[i].count;
+}
+
+long fqBucketDrops(int i)
+{
+    return fqBuckets[i].drops;
+}
+
+long fqBacklogSize()
+{
+    return fqBacklog;
+}
+
+// 上游应答的QR位为1，这类任务已经付出过一次上游往返，不丢弃；
+// QR位客户端也能随便设，还要求报文来自上游地址（工作线程的上游socket收到的应答来源地址就是上游地址）
+static int isUpstreamResponse(Task *t)
+{
+    return t->len > 2 && (t->buf[2] & 0x80) &&
+           t->clientAddr.sin_addr.s_addr == remoteSockAddr.sin_addr.s_addr &&
+           t->clientAddr.sin_port == remoteSockAddr.sin_port;
+}
+
+// 入口分类：上游应答和可能命中缓存的A查询走高优先级，其余走低优先级
+static int classifyTask(Task *t)
+{
+    if (priority_weight <= 0)
+    {
+        return LANE_LOW;
+    }
+    if (isUpstreamResponse(t))
+    {
+        return LANE_HIGH;
+    }
+    int nameLen;
+    const uint8_t *q = (const uint8_t *)t->buf + DNS_HEADER_SIZE;
+    int left = t->len - DNS_HEADER_SIZE;
+    if (left <= 0 || !cache_may_contain(q, left, &nameLen) || nameLen + 2 > left)
+    {
+        return LANE_LOW;
+    }
+    return ((q[nameLen] << 8) | q[nameLen + 1]) == RR_A ? LANE_HIGH : LANE_LOW;
+}
+
+// 从first开始找一个该通道没满的队列放入任务，返回队列下标，全部满时返回-1
+// 高优先级通道都满时借用低优先级通道，不为此阻塞
+static int tryEnqueueAny(Task *t, int first, int lane)
+{
+    long n = my_atomicLoad(&pool_size);
+    for (; lane < LANE_COUNT; lane++)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            int i = (int)((first + k) % n);
+            if (ringTryEnqueue(&workers[i]->lanes[lane], t))
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// 入队，目标队列满时顺延到下一个，全部满时阻塞直到有空位；返回实际使用的队列
+// 开启队列管理时，全部满了的客户端查询直接丢弃并返回-1，不阻塞接收线程
+static int enqueueTask(Task *t)
+{
+    int first = pickWorker(t);
+    int lane = classifyTask(t);
+    int i;
+    stats_add(lane == LANE_HIGH ? &stats.lane_high : &stats.lane_low, 1);
+    // 公平队列只在拥塞时介入：目标队列有空位且公平队列为空时直接入队，只多一次原子读
+    if (fair_queue && !isUpstreamResponse(t))
+    {
+        if (my_atomicLoad(&fqBacklog) == 0 && ringTryEnqueue(&workers[first]->lanes[lane], t))
+        {
+            return first;
+        }
+        return fqEnqueue(t) ? first : -1;
+    }
+    while ((i = tryEnqueueAny(t, first, lane)) < 0)
+    {
+        if (aqm_target_us > 0 && !isUpstreamResponse(t))
+        {
+            stats_add(&stats.shed_overflow, 1);
+            freePacket(t->pkt);
+            return -1;
+        }
+        int key = my_prepareWait(&slotFree);
+        if ((i = tryEnqueueAny(t, first, lane)) >= 0)
+        {
+            my_cancelWait(&slotFree);
+            break;
+        }
+        my_waitEvent(&slotFree, key);
+    }
+    return i;
+}
+
+int rejectTask(Task *t)
+{
+    int reason = prefilter ? check_message((uint8_t *)t->buf, t->len) : CHECK_OK;
+    switch (reason)
+    {
+    case CHECK_OK:
+        return 0;
+    case CHECK_RUNT:
+        stats_add(&stats.reject_runt, 1);
+        break;
+    case CHECK_HEADER:
+        stats_add(&stats.reject_header, 1);
+        break;
+    case CHECK_COUNTS:
+        stats_add(&stats.reject_counts, 1);
+        break;
+    default:
+        stats_add(&stats.reject_question, 1);
+        break;
+    }
+    debug_print1("Rejected malformed packet (reason %d) from %s:%d\n", reason,
+                 inet_ntoa(t->clientAddr.sin_addr), ntohs(t->clientAddr.sin_port));
+
+    // 只给查询回FORMERR，应答报文（不管从哪来）和不够头部的报文一律丢弃，免得和对端互相回错误
+    if (reject_rcode >= 0 && reason != CHECK_RUNT && !(t->buf[2] & 0x80))
+    {
+        int len = set_error_response((uint8_t *)t->buf, t->len, reject_rcode);
+        sendPacket(t->sock, t->buf, len, &(t->clientAddr));
+    }
+    return 1;
+}
 
 void addTask(Task *t)
 {
-    my_waitSemaphore(queueNotFull);
-    my_lockMutex(queueMutex);
-    taskQueue[taskTail] = *t;
-    taskTail = (taskTail + 1) % TASK_QUEUE_SIZE;
-    my_unlockMutex(queueMutex);
-    my_postSemaphore(queueNotEmpty);
+    if (rejectTask(t))
+    {
+        freePacket(t->pkt);
+        flushPackets();
+        return;
+    }
+    if (inline_handler && inline_handler(t))
+    {
+        freePacket(t->pkt);
+        flushPackets();
+        return;
+    }
+    t->enqueueNs = my_nowNs();
+    int i = enqueueTask(t);
+    if (i >= 0)
+    {
+        wakeWorkers(i);
+    }
 }
 
-static int getTask(Task *t)
+void addTasks(Task *ts, int n)
 {
-    my_waitSemaphore(queueNotEmpty);
-    my_lockMutex(queueMutex);
-    *t = taskQueue[taskHead];
-    taskHead = (taskHead + 1) % TASK_QUEUE_SIZE;
-    my_unlockMutex(queueMutex);
-    my_postSemaphore(queueNotFull);
+    // 同一批报文是一起收到的，共用一个时间戳
+    unsigned long long now = my_nowNs();
+    int answered = 0;
+    for (int k = 0; k < n; k++)
+    {
+        if (rejectTask(&ts[k]))
+        {
+            freePacket(ts[k].pkt);
+            answered |= reject_rcode >= 0;
+            continue;
+        }
+        if (inline_handler && inline_handler(&ts[k]))
+        {
+            freePacket(ts[k].pkt);
+            answered = 1;
+            continue;
+        }
+        ts[k].enqueueNs = now;
+        int i = enqueueTask(&ts[k]);
+        if (i >= 0)
+        {
+            wakeWorkers(i);
+        }
+    }
+    // 接收线程直接回的包攒成一批发出
+    if (answered)
+    {
+        flushPackets();
+    }
+}
+
+Task *allocTaskBatch(my_packet *pkts, int n)
+{
+    Task *batch = malloc(sizeof(Task) * n);
+    if (!batch)
+    {
+        printf("Error: Failed to allocate receive batch.\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        refillTask(&batch[i], &pkts[i]);
+    }
+    return batch;
+}
+
+void refillTask(Task *t, my_packet *pkt)
+{
+    t->pkt = allocPacket(SIZE);
+    t->buf = t->pkt->data;
+    pkt->buf = t->buf;
+    pkt->size = SIZE;
+    pkt->addr = &t->clientAddr;
+}
+
+void receiveBatch(my_socket s)
+{
+    my_packet pkts[MY_MAX_BATCH];
+    Task *batch = allocTaskBatch(pkts, recv_batch);
+
+    for (;;)
+    {
+        int n = my_recvBatch(s, pkts, recv_batch);
+        if (n < 0)
+        {
+            perror("recvmmsg");
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            batch[i].len = pkts[i].len;
+            batch[i].clientAddrLen = sizeof(batch[i].clientAddr);
+            batch[i].sock = s;
+            batch[i].upstreamSock = s;
+            batch[i].upstreamAddr = &remoteSockAddr;
+        }
+        stats_add(&stats.recv_calls, 1);
+        stats_add(&stats.recv_packets, n);
+        addTasks(batch, n);
+
+        // 缓冲区已随任务交给工作线程，换上新的
+        for (int i = 0; i < n; i++)
+        {
+            refillTask(&batch[i], &pkts[i]);
+        }
+    }
+}
+
+void countShardPackets(int i, int n)
+{
+    stats_add(&shardRecv[i % MAX_SHARDS], n);
+}
+
+long shardPackets(int i)
+{
+    return shardRecv[i];
+}
+
+void flushPackets()
+{
+    SendBatch *b = localBatch;
+    if (!b || b->count == 0)
+    {
+        return;
+    }
+    if (my_sendBatch(b->sock, b->pkts, b->count) < 0)
+    {
+        perror("sendmmsg");
+    }
+    stats_add(&stats.send_calls, 1);
+    stats_add(&stats.send_packets, b->count);
+    b->count = 0;
+}
+
+void setSendUring(my_uring *u)
+{
+    localUring = u;
+}
+
+my_socket openUpstreamSocket()
+{
+    my_socket s = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == MY_INVALID_SOCKET)
+    {
+        return s;
+    }
+    if (connect(s, (struct sockaddr *)&remoteSockAddr, sizeof(remoteSockAddr)) != 0)
+    {
+        my_closeSocket(s);
+        return MY_INVALID_SOCKET;
+    }
+    return s;
+}
+
+void sendPacket(my_socket s, const char *buf, int len, struct sockaddr_in *addr)
+{
+    if (s == localUpstream)
+    {
+        localPending++;
+        localLastForward = time(NULL);
+    }
+    // io_uring的发送槽位用完时退回普通发送
+    if (localUring && my_uringSend(localUring, s, buf, len, addr) == 0)
+    {
+        stats_add(&stats.send_packets, 1);
+        return;
+    }
+    if (send_batch > 1 && !localBatch)
+    {
+        localBatch = malloc(sizeof(SendBatch));
+        if (localBatch)
+        {
+            localBatch->count = 0;
+        }
+    }
+    if (send_batch <= 1 || !localBatch || len > SIZE)
+    {
+        sendto(s, buf, len, 0, (struct sockaddr *)addr, addr ? sizeof(*addr) : 0);
+        stats_add(&stats.send_calls, 1);
+        stats_add(&stats.send_packets, 1);
+        return;
+    }
+
+    // 一个批次只能走同一个socket
+    SendBatch *b = localBatch;
+    if (b->count > 0 && b->sock != s)
+    {
+        flushPackets();
+    }
+
+    int i = b->count++;
+    b->sock = s;
+    memcpy(b->bufs[i], buf, len);
+    b->pkts[i].buf = b->bufs[i];
+    b->pkts[i].size = SIZE;
+    b->pkts[i].len = len;
+    b->pkts[i].addr = NULL;
+    if (addr)
+    {
+        b->addrs[i] = *addr;
+        b->pkts[i].addr = &b->addrs[i];
+    }
+
+    if (b->count >= send_batch)
+    {
+        flushPackets();
+    }
+}
+
+// CoDel控制器状态，每个工作线程一份，只看自己取出的任务
+typedef struct
+{
+    unsigned long long firstAbove; // 排队时间持续超过目标的起点+interval，0表示当前未超标
+    unsigned long long dropNext;   // 丢弃状态下下一次丢弃的时间
+    unsigned int count;            // 本轮丢弃状态下已丢弃的个数
+    int dropping;
+} CoDel;
+
+static my_thread_local CoDel localCodel;
+
+static unsigned int isqrt(unsigned int x)
+{
+    unsigned int r = 0;
+    for (unsigned int bit = 1u << 30; bit; bit >>= 2)
+    {
+        if (x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+// 丢弃状态下相邻两次丢弃的间隔为interval/sqrt(count)，持续拥塞时越丢越快
+static unsigned long long codelControlLaw(unsigned long long t, unsigned int count)
+{
+    unsigned int root = isqrt(count);
+    return t + (unsigned long long)aqm_interval_us * 1000ULL / (root ? root : 1);
+}
+
+// 排队时间超过目标持续一个interval后进入丢弃状态，按控制律间隔丢弃，降回目标以下即退出
+static int codelShouldShed(CoDel *c, unsigned long long now, unsigned long long sojournNs)
+{
+    if (sojournNs < (unsigned long long)aqm_target_us * 1000ULL)
+    {
+        c->firstAbove = 0;
+        c->dropping = 0;
+        return 0;
+    }
+    if (c->firstAbove == 0)
+    {
+        c->firstAbove = now + (unsigned long long)aqm_interval_us * 1000ULL;
+        return 0;
+    }
+    if (now < c->firstAbove)
+    {
+        return 0;
+    }
+    if (!c->dropping)
+    {
+        // 刚退出丢弃状态不久又拥塞，从上次的丢弃频率附近继续
+        int recent = c->count > 2 && now - c->dropNext < 16ULL * aqm_interval_us * 1000ULL;
+        c->count = recent ? c->count - 2 : 1;
+        c->dropping = 1;
+        c->dropNext = codelControlLaw(now, c->count);
+        return 1;
+    }
+    if (now >= c->dropNext)
+    {
+        c->count++;
+        c->dropNext = codelControlLaw(c->dropNext, c->count);
+        return 1;
+    }
+    return 0;
+}
+
+// 记录任务的排队时间，队列管理判定需要减载时丢弃或直接回错误应答，返回1表示任务已处理
+static int shedTask(Task *t, unsigned long long now)
+{
+    unsigned long long sojourn = now > t->enqueueNs ? now - t->enqueueNs : 0;
+    stats_delay((long)(sojourn / 1000));
+
+    // 上游应答从不减载，也不计入CoDel状态，否则会让之后的查询丢得比控制律更快
+    if (aqm_target_us == 0 || isUpstreamResponse(t) || !codelShouldShed(&localCodel, now, sojourn))
+    {
+        return 0;
+    }
+    stats_add(&stats.shed_aqm, 1);
+    if (shed_rcode >= 0)
+    {
+        int len = set_error_response((uint8_t *)t->buf, t->len, shed_rcode);
+        if (len > 0)
+        {
+            sendPacket(t->sock, t->buf, len, &t->clientAddr);
+        }
+    }
     return 1;
 }
 
+static Worker *createWorker(int index)
+{
+    Worker *w = my_alignedAlloc(CACHE_LINE, sizeof(Worker));
+    if (!w)
+    {
+        printf("Error: Failed to allocate worker queue.\n");
+        exit(1);
+    }
+    for (int lane = 0; lane < LANE_COUNT; lane++)
+    {
+        ringInit(&w->lanes[lane]);
+    }
+    my_initEvent(&w->ready);
+    w->steals = 0;
+    w->busyNs = 0;
+    w->delayUs = 0;
+    w->tasks = 0;
+    w->index = index;
+    // 工作线程要同时等任务和自己的上游socket时，改用可轮询信号量唤醒
+    w->doorbell = connect_upstream ? my_createPollableSemaphore(0, TASK_QUEUE_SIZE) : NULL;
+    return w;
+}
+
+// 等已经计入pool_size的工作线程都登记完
+static void waitWorkersReady()
+{
+    while (my_atomicLoad(&worker_count) < my_atomicLoad(&pool_size))
+    {
+        my_sleep(1);
+    }
+}
+
+// 按权重从一个工作线程的两条通道里取任务：高优先级每连续取priority_weight个，让低优先级取一个
+static int dequeueWeighted(Worker *w, Task *t)
+{
+    int first = highStreak >= priority_weight ? LANE_LOW : LANE_HIGH;
+    int lane = first;
+    if (!ringTryDequeue(&w->lanes[lane], t))
+    {
+        lane = !first;
+        if (!ringTryDequeue(&w->lanes[lane], t))
+        {
+            return 0;
+        }
+    }
+    highStreak = lane == LANE_HIGH ? highStreak + 1 : 0;
+    return 1;
+}
+
+// 先取自己队列，再取公平队列，都空了再从后面的线程队列里偷
+// 被缩容退出线程池的线程只把自己队列里剩下的任务处理完，不再取别处的任务
+static int tryGetTask(Worker *w, Task *t)
+{
+    long n = my_atomicLoad(&pool_size);
+    int active = w->index < n;
+    int got = dequeueWeighted(w, t);
+    if (!got && active && my_atomicLoad(&fqBacklog) > 0)
+    {
+        got = fqDequeue(t);
+    }
+    for (int k = 1; !got && active && k < n; k++)
+    {
+        Worker *victim = workers[(w->index + k) % n];
+        if (workerDepth(victim) > 0 && dequeueWeighted(victim, t))
+        {
+            w->steals++;
+            got = 1;
+        }
+    }
+    if (got)
+    {
+        my_notifyEvent(&slotFree, 1);
+    }
+    return got;
+}
+
+typedef struct
+{
+    Worker *w;
+    Task *t;
+} TaskPoll;
+
+static int pollTask(void *arg)
+{
+    TaskPoll *p = (TaskPoll *)arg;
+    return tryGetTask(p->w, p->t);
+}
+
+// 自旋的时间和结果计入统计，用来权衡多烧的CPU和少付的唤醒延迟
+static void recordIdleWait(int parks, unsigned long long spentNs)
+{
+    if (spin_us > 0)
+    {
+        stats_add(&stats.spin_us, (long)(spentNs / 1000));
+        if (parks == 0)
+        {
+            stats_add(&stats.spin_hits, 1);
+        }
+    }
+    stats_add(&stats.worker_parks, parks);
+}
+
+// 所有队列都空时先自旋spin_us微秒，仍然没有任务才挂起
+static int getTask(Worker *w, Task *t)
+{
+    // 队列空了才把本地缓存的缓冲区还给接收线程，忙的时候不为此加锁
+    if (tryGetTask(w, t))
+    {
+        return 1;
+    }
+    releasePackets();
+
+    TaskPoll p = {w, t};
+    unsigned long long spent = 0;
+    int parks = my_spinThenWait(&w->ready, pollTask, &p, spin_us, &spent);
+    recordIdleWait(parks, spent);
+    return 1;
+}
+
+// 收完本线程上游socket上已经到达的应答并逐个处理
+static void receiveUpstream(void (*handler)(Task *), my_socket up)
+{
+    int got = 0;
+    PacketBuf *pkt = allocPacket(SIZE);
+    for (;;)
+    {
+        Task t;
+        t.buf = pkt->data;
+        t.pkt = NULL;
+        t.len = recv(up, t.buf, SIZE, 0);
+        if (t.len < 0)
+        {
+            break;
+        }
+        t.clientAddr = remoteSockAddr;
+        t.clientAddrLen = sizeof(t.clientAddr);
+        t.sock = servSock;
+        t.upstreamSock = up;
+        t.upstreamAddr = NULL;
+        stats_add(&stats.recv_calls, 1);
+        stats_add(&stats.recv_packets, 1);
+        debug_print2("Receive %d bytes from upstream on worker socket\n", t.len);
+
+        got++;
+        if (rejectTask(&t))
+        {
+            continue;
+        }
+        handler(&t);
+    }
+    freePacket(pkt);
+
+    localPending -= got;
+    // 上游丢了应答时在途计数不会归零，超过ID有效期后直接清零
+    if (localPending < 0 || (got == 0 && time(NULL) - localLastForward > ID_EXPIRE_TIME))
+    {
+        localPending = 0;
+    }
+}
+
 void *workerThread(void *lpParam)
 {
     void (*handler)(Task *) = (void (*)(Task *))lpParam;
+    int index = (int)my_atomicAdd(&workerSeq, 1);
+    bindWorker(index);
+    Worker *w = createWorker(index);
+    workers[index] = w;
+    my_atomicAdd(&worker_count, 1);
+    // 等初始的工作线程都登记完再开始取任务，之后workers[]只会在末尾追加
+    waitWorkersReady();
+    my_socket upstream = MY_INVALID_SOCKET;
+    my_waiter *waiter = NULL;
+
+    // 每个工作线程独占一个已连接的上游socket，自己转发的查询的应答也由自己接收
+    if (connect_upstream)
+    {
+        upstream = openUpstreamSocket();
+        if (upstream != MY_INVALID_SOCKET && w->doorbell)
+        {
+            waiter = my_createWaiter(w->doorbell, upstream);
+        }
+        if (!waiter)
+        {
+            printf("Worker upstream socket unavailable, forwarding through the shared socket.\n");
+            // 不再等在可轮询信号量上，之后由ready唤醒；信号量可能正被投递方使用，不销毁
+            w->doorbell = NULL;
+            if (upstream != MY_INVALID_SOCKET)
+            {
+                my_closeSocket(upstream);
+            }
+            upstream = MY_INVALID_SOCKET;
+        }
+        localUpstream = upstream;
+    }
 
     while (1)
     {
         Task t;
-        getTask(&t);
+        if (waiter)
+        {
+            // 有在途的转发时先收上游应答，避免被排队的客户端查询挤在后面
+            if (localPending > 0)
+            {
+                receiveUpstream(handler, upstream);
+            }
+            if (!tryGetTask(w, &t))
+            {
+                flushPackets();
+                releasePackets();
+                // 自旋期间只看任务队列，上游应答在挂起时由waiter一并等待
+                TaskPoll p = {w, &t};
+                unsigned long long spent = 0;
+                int got = my_spinUntil(pollTask, &p, spin_us, &spent);
+                if (!got)
+                {
+                    my_prepareWait(&w->ready);
+                    got = tryGetTask(w, &t);
+                    if (got)
+                    {
+                        my_cancelWait(&w->ready);
+                    }
+                }
+                recordIdleWait(got ? 0 : 1, spent);
+                if (!got)
+                {
+                    // 信号只是提示，可能已被别的线程抢先取走任务
+                    int woken = my_waiterWait(waiter);
+                    my_cancelWait(&w->ready);
+                    if (woken != 1 || !tryGetTask(w, &t))
+                    {
+                        receiveUpstream(handler, upstream);
+                        continue;
+                    }
+                }
+            }
+            t.upstreamSock = upstream;
+            t.upstreamAddr = NULL;
+        }
+        // 队列空了就先把攒着的回包发出去，再阻塞等待
+        else if (send_batch <= 1 || !tryGetTask(w, &t))
+        {
+            flushPackets();
+            getTask(w, &t);
+        }
+        unsigned long long start = my_nowNs();
+        w->tasks++;
+        w->delayUs += start > t.enqueueNs ? (start - t.enqueueNs) / 1000 : 0;
+        if (shedTask(&t, start))
+        {
+            freePacket(t.pkt);
+            continue;
+        }
         debug_print2("Receive %d bytes from %s:%d\n", t.len,
                      inet_ntoa(t.clientAddr.sin_addr), ntohs(t.clientAddr.sin_port));
-        debug_dns_message_hex(t.buf, t.len);
+        debug_dns_message_hex((unsigned char *)t.buf, t.len);
 
         handler(&t);
+        freePacket(t.pkt);
+        w->busyNs += my_nowNs() - start;
+    }
+    return NULL;
+}
+
+void *shardThread(void *lpParam)
+{
+    Shard *shard = (Shard *)lpParam;
+    bindReceiver(shard->index);
+    my_packet pkts[MY_MAX_BATCH];
+    Task *batch = allocTaskBatch(pkts, recv_batch);
+
+    for (;;)
+    {
+        int n = my_recvBatch(shard->sock, pkts, recv_batch);
+        if (n < 0)
+        {
+            perror("recvfrom");
+            continue;
+        }
+        stats_add(&stats.recv_calls, 1);
+        stats_add(&stats.recv_packets, n);
+        countShardPackets(shard->index, n);
+
+        // 不经过任务队列，直接在本线程处理
+        for (int i = 0; i < n; i++)
+        {
+            Task *t = &batch[i];
+            t->len = pkts[i].len;
+            t->clientAddrLen = sizeof(t->clientAddr);
+            t->sock = shard->sock;
+            t->upstreamSock = shard->sock;
+            t->upstreamAddr = &remoteSockAddr;
+            debug_print2("Receive %d bytes from %s:%d\n", t->len,
+                         inet_ntoa(t->clientAddr.sin_addr), ntohs(t->clientAddr.sin_port));
+            debug_dns_message_hex((unsigned char *)t->buf, t->len);
+
+            if (!rejectTask(t))
+            {
+                shard->handler(t);
+            }
+        }
+        flushPackets();
+    }
+    return NULL;
+}
+
+// 扩容一个工作线程：优先让之前缩容退出的线程回到线程池，没有时新建线程
+static void growPool()
+{
+    long n = my_atomicLoad(&pool_size);
+    if (n < my_atomicLoad(&worker_count))
+    {
+        my_atomicStore(&pool_size, n + 1);
+        return;
+    }
+    if (!my_createThread(workerThread, (void *)workerHandler))
+    {
+        return;
+    }
+    while (my_atomicLoad(&worker_count) <= n)
+    {
+        my_sleep(1);
+    }
+    my_atomicStore(&pool_size, n + 1);
+}
+
+// 缩容一个工作线程：下标最大的线程不再分到新任务，处理完自己队列里的任务后闲置
+static void shrinkPool()
+{
+    my_atomicStore(&pool_size, my_atomicLoad(&pool_size) - 1);
+}
+
+// 线程池调整线程：每POOL_ADJUST_MS统计一次工作线程的忙碌比例和排队时间，每次最多增减一个线程
+static void *poolThread(void *lpParam)
+{
+    (void)lpParam;
+    unsigned long long lastBusy = 0, lastDelay = 0, lastTasks = 0;
+    unsigned long long lastTime = my_nowNs();
+
+    while (1)
+    {
+        my_sleep(POOL_ADJUST_MS);
+        unsigned long long busy = 0, delay = 0, tasks = 0;
+        long created = my_atomicLoad(&worker_count);
+        for (int i = 0; i < created; i++)
+        {
+            busy += workers[i]->busyNs;
+            delay += workers[i]->delayUs;
+            tasks += workers[i]->tasks;
+        }
+        unsigned long long now = my_nowNs();
+        long n = my_atomicLoad(&pool_size);
+        double util = (double)(busy - lastBusy) / ((double)(now - lastTime) * n);
+        unsigned long long avgDelay = tasks > lastTasks ? (delay - lastDelay) / (tasks - lastTasks) : 0;
+        lastBusy = busy;
+        lastDelay = delay;
+        lastTasks = tasks;
+        lastTime = now;
+        pool_util = (int)(util * 100);
+
+        if (n < pool_max && pool_util > POOL_GROW_UTIL && avgDelay > POOL_GROW_DELAY_US)
+        {
+            growPool();
+            stats_add(&stats.pool_grows, 1);
+            debug_print1("Worker pool grown to %ld (util %d%%, delay %llu us)\n", n + 1, pool_util, avgDelay);
+        }
+        else if (n > pool_min && pool_util < POOL_SHRINK_UTIL)
+        {
+            shrinkPool();
+            stats_add(&stats.pool_shrinks, 1);
+            debug_print1("Worker pool shrunk to %ld (util %d%%)\n", n - 1, pool_util);
+        }
     }
     return NULL;
 }
 
+void startWorkerPool(void (*handler)(Task *))
+{
+    workerHandler = handler;
+    my_atomicStore(&pool_size, pool_min);
+    for (int i = 0; i < pool_min; i++)
+    {
+        my_createThread(workerThread, (void *)handler);
+    }
+    waitWorkersReady();
+    if (pool_max > pool_min)
+    {
+        my_createThread(poolThread, NULL);
+    }
+}
+
 void initLockAndSemaphore()
 {
-    // 多线程操作使用的三个句柄，互斥锁和两个信号量，两个信号量用于防止CPU忙等待
-    queueMutex = my_createMutex();
+    // 任务队列本身无锁，锁只用于ID表、日志和缓存
     ID_list_Mutex = my_createMutex();
     log_Mutex = my_createMutex();
     hash_table_Mutex = my_createMutex();
-    queueNotEmpty = my_createSemaphore(0, TASK_QUEUE_SIZE);
-    queueNotFull = my_createSemaphore(TASK_QUEUE_SIZE, TASK_QUEUE_SIZE);
+    fqMutex = my_createMutex();
+    my_initEvent(&slotFree);
 }
\ No newline at end of file
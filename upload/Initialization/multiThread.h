@@ -5,30 +5,123 @@
 #include "platformThread.h"
 #include "platformSocket.h"
 #include "debug.h"
+#include "stats.h"
+#include "platformUring.h"
+#include "platformEvent.h"
+#include "packetPool.h"
+#include "placement.h"
 
 #define SIZE 512
-#define THREAD_POOL_SIZE 28
-#define TASK_QUEUE_SIZE 64
+#define MAX_WORKERS 256 // 工作线程数上限
+#define POOL_ADJUST_MS 1000     // 线程池调整周期
+#define POOL_GROW_UTIL 75       // 工作线程忙碌百分比超过该值且排队时间超标时扩容
+#define POOL_GROW_DELAY_US 1000
+#define POOL_SHRINK_UTIL 25     // 工作线程忙碌百分比低于该值时缩容
+#define TASK_QUEUE_SIZE 64 // 每个工作线程任务队列的容量，必须是2的幂
+#define MAX_SHARDS 64
+#define FQ_BUCKETS 128           // 公平队列按客户端地址哈希分的桶数
+#define FQ_BUCKET_DEPTH 16       // 每个桶最多排多少个查询
+#define FQ_QUANTUM MAX_DNS_SIZE  // 每轮给一个桶补充的赤字（字节）
 
+// 任务只是报文的描述，报文本身在缓冲池中，入队出队不拷贝报文
 typedef struct
 {
-    char buf[SIZE];
+    char *buf; // 报文数据
     int len;
     struct sockaddr_in clientAddr;
     int clientAddrLen;
+    my_socket sock;         // 面向客户端的socket，回包从这里发出
+    my_socket upstreamSock; // 转发给上游服务器时使用的socket
+    struct sockaddr_in *upstreamAddr; // 上游地址，upstreamSock已connect时为NULL
+    PacketBuf *pkt;                   // buf所在的缓冲区，处理完由工作线程归还；NULL表示缓冲区不归任务所有
+    unsigned long long enqueueNs;     // 进入任务队列的时间，用于计算排队时间
 } Task;
 
-extern my_mutex *queueMutex;
-extern my_semaphore *queueNotEmpty;
-extern my_semaphore *queueNotFull;
-extern int taskHead, taskTail;
-extern Task taskQueue[TASK_QUEUE_SIZE];
+// SO_REUSEPORT分片，每个分片独占一个socket和一个线程，收包、处理、回包都在本线程完成
+typedef struct
+{
+    my_socket sock;
+    void (*handler)(Task *);
+    int index; // 分片序号，决定绑定到接收CPU集合中的哪一个
+} Shard;
+
+extern int recv_batch; // 每次批量接收的最大报文数，1表示逐个recvfrom
+extern int send_batch; // 每个工作线程攒够多少个报文再sendmmsg，1表示立即sendto
+extern int shard_count; // SO_REUSEPORT分片数，0表示使用接收线程+线程池
+extern int process_count; // 工作进程数，0表示单进程
+extern int process_index; // 本进程的编号，单进程时为-1
+extern int qname_steer;   // 是否按域名在SO_REUSEPORT的socket之间分配报文
+extern int connect_upstream; // 每个工作线程/事件循环是否使用自己的已连接上游socket
+extern int flow_hash; // 按客户端地址哈希选择工作线程队列，0表示轮转
+extern unsigned int spin_us; // 工作线程没有任务时先自旋多少微秒再挂起，0表示立即挂起
+extern unsigned int aqm_target_us;   // CoDel目标排队时间（微秒），0表示不做队列管理
+extern unsigned int aqm_interval_us; // CoDel观察窗口（微秒）
+extern int shed_rcode;               // 减载时回给客户端的rcode，-1表示直接丢弃
+extern int priority_weight; // 高优先级通道每取几个任务让低优先级取一个，0表示不分通道
+extern int fair_queue;      // 拥塞时是否按客户端做公平排队
+extern int (*inline_handler)(Task *); // 接收线程入队前先调用，返回1表示已在接收线程处理完，NULL表示不启用
+extern int prefilter;                 // 是否在入口检查报文格式
+extern int reject_rcode;              // 格式不对的查询回给客户端的rcode，-1表示直接丢弃
+extern volatile long worker_count; // 已分配好任务队列的工作线程数，包括缩容后闲置的
+extern volatile long pool_size;    // 当前参与分配任务的工作线程数
+extern int pool_min;               // 线程池大小的下限和上限，相等时不做动态调整
+extern int pool_max;
+extern int pool_util;              // 最近一个调整周期内工作线程的忙碌百分比
 
-// 加任务，入队列
+extern my_socket servSock;
+extern struct sockaddr_in servSockAddr, remoteSockAddr;
+
+// 加任务，入队列；开启队列管理且所有队列都满时丢弃客户端查询
 void addTask(Task *t);
 
+// 批量加任务
+void addTasks(Task *ts, int n);
+
+// 分配n个Task并从缓冲池挂上缓冲区，同时填好批量接收用的报文描述
+Task *allocTaskBatch(my_packet *pkts, int n);
+
+// Task的缓冲区已交给别的线程，重新挂一个新的
+void refillTask(Task *t, my_packet *pkt);
+
+// 批量接收报文并投递到任务队列，不返回
+void receiveBatch(my_socket s);
+
+// 发送报文，开启批量发送时先放入本线程的发送批次；addr为NULL表示s已connect
+void sendPacket(my_socket s, const char *buf, int len, struct sockaddr_in *addr);
+
+// 打开一个connect到上游服务器的UDP socket，失败返回MY_INVALID_SOCKET
+my_socket openUpstreamSocket();
+
+// 发出本线程发送批次中的所有报文
+void flushPackets();
+
+// 每个分片socket（或事件循环）收到的报文数，用于观察按域名分配是否均衡
+void countShardPackets(int i, int n);
+long shardPackets(int i);
+
+// 入口检查，格式不对的报文计数并按reject_rcode处理，返回1表示调用方应丢掉该任务
+int rejectTask(Task *t);
+
+// 本线程之后的sendPacket改为排进io_uring，NULL表示恢复普通发送
+void setSendUring(my_uring *u);
+
 void *workerThread(void *lpParam);
 
+// 启动pool_min个工作线程并等它们都分配好自己的任务队列，上下限不同时再启动线程池调整线程
+void startWorkerPool(void (*handler)(Task *));
+
+// 分片线程，参数为Shard*，不返回
+void *shardThread(void *lpParam);
+
+// 第i个工作线程队列当前的任务数和它偷到的任务数，用于统计输出
+int workerQueueDepth(int i);
+long workerSteals(int i);
+
+// 公平队列第i个桶当前排队数、累计丢弃数，以及所有桶的排队总数
+int fqBucketDepth(int i);
+long fqBucketDrops(int i);
+long fqBacklogSize();
+
 void initLockAndSemaphore();
 
 #endif
\ No newline at end of file
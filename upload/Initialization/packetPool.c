@@ -0,0 +1,152 @@
+#include "packetPool.h"
+#include "stats.h"
+#include "debug.h"
+
+static const int classSize[PACKET_CLASSES] = {PACKET_SMALL};
+static int classCount[PACKET_CLASSES];
+
+// 全局空闲链表，每个大小类一个锁
+static PacketBuf *freeList[PACKET_CLASSES];
+static my_mutex *poolMutex[PACKET_CLASSES];
+
+// 线程本地的空闲缓冲区缓存，分配和归还大多不需要加锁
+static my_thread_local PacketBuf *localFree[PACKET_CLASSES];
+static my_thread_local int localCount[PACKET_CLASSES];
+
+void initPacketPool(int threads)
+{
+    for (int c = 0; c < PACKET_CLASSES; c++)
+    {
+        classCount[c] = PACKET_SMALL_COUNT + threads * PACKET_LOCAL_CACHE;
+        PacketBuf *descs = malloc(sizeof(PacketBuf) * classCount[c]);
+        char *region = my_alignedAlloc(CACHE_LINE, (size_t)classSize[c] * classCount[c]);
+        if (!descs || !region)
+        {
+            printf("Error: Failed to allocate packet pool.\n");
+            exit(1);
+        }
+
+        poolMutex[c] = my_createMutex();
+        freeList[c] = NULL;
+        for (int i = 0; i < classCount[c]; i++)
+        {
+            descs[i].data = region + (size_t)classSize[c] * i;
+            descs[i].size = classSize[c];
+            descs[i].cls = c;
+            descs[i].next = freeList[c];
+            freeList[c] = &descs[i];
+        }
+    }
+    debug_print1("Packet pool initialized: %d x %d bytes\n", classCount[0], classSize[0]);
+}
+
+// 从全局链表一次搬半个本地缓存的量到本线程
+static void refillLocal(int c)
+{
+    my_lockMutex(poolMutex[c]);
+    while (freeList[c] && localCount[c] < PACKET_LOCAL_CACHE / 2)
+    {
+        PacketBuf *p = freeList[c];
+        freeList[c] = p->next;
+        p->next = localFree[c];
+        localFree[c] = p;
+        localCount[c]++;
+    }
+    my_unlockMutex(poolMutex[c]);
+}
+
+// 本地缓存留下keep个，其余在锁外串成一条链，加一次锁整条接到全局链表上
+static void spillLocal(int c, int keep)
+{
+    if (localCount[c] <= keep)
+    {
+        return;
+    }
+    PacketBuf *first = localFree[c];
+    PacketBuf *last = first;
+    for (int i = localCount[c] - keep; i > 1; i--)
+    {
+        last = last->next;
+    }
+    localFree[c] = last->next;
+    localCount[c] = keep;
+
+    my_lockMutex(poolMutex[c]);
+    last->next = freeList[c];
+    freeList[c] = first;
+    my_unlockMutex(poolMutex[c]);
+}
+
+PacketBuf *allocPacket(int size)
+{
+    int c = 0;
+    while (c < PACKET_CLASSES && classSize[c] < size)
+    {
+        c++;
+    }
+
+    if (c < PACKET_CLASSES)
+    {
+        if (localCount[c] == 0)
+        {
+            refillLocal(c);
+        }
+        if (localCount[c] > 0)
+        {
+            PacketBuf *p = localFree[c];
+            localFree[c] = p->next;
+            localCount[c]--;
+            p->next = NULL;
+            return p;
+        }
+    }
+
+    // 缓冲池用完或者超过最大的大小类，临时分配
+    stats_add(&stats.pool_fallbacks, 1);
+    PacketBuf *p = malloc(sizeof(PacketBuf));
+    if (!p)
+    {
+        return NULL;
+    }
+    p->size = c < PACKET_CLASSES ? classSize[c] : size;
+    p->data = malloc(p->size);
+    p->cls = -1;
+    p->next = NULL;
+    if (!p->data)
+    {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void freePacket(PacketBuf *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    if (p->cls < 0)
+    {
+        free(p->data);
+        free(p);
+        return;
+    }
+
+    int c = p->cls;
+    p->next = localFree[c];
+    localFree[c] = p;
+    localCount[c]++;
+    if (localCount[c] > PACKET_LOCAL_CACHE)
+    {
+        spillLocal(c, PACKET_LOCAL_CACHE / 2);
+    }
+}
+
+void releasePackets()
+{
+    for (int c = 0; c < PACKET_CLASSES; c++)
+    {
+        spillLocal(c, 0);
+    }
+}
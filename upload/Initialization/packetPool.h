@@ -0,0 +1,38 @@
+#ifndef PACKETPOOL_H
+#define PACKETPOOL_H
+
+#include "header.h"
+#include "platformThread.h"
+
+// 报文缓冲区大小类，目前只有普通UDP报文一类，更大的报文临时malloc
+#define PACKET_CLASSES 1
+#define PACKET_SMALL 512
+#define PACKET_SMALL_COUNT 2048 // 除各线程本地缓存外留给在途报文的缓冲区数
+
+#define CACHE_LINE 64
+#define PACKET_LOCAL_CACHE 32 // 每个线程每个大小类最多缓存的空闲缓冲区数
+
+// 报文缓冲区描述，data按缓存行对齐；任务队列中只传递描述的指针
+typedef struct PacketBuf
+{
+    char *data;
+    int size;               // 容量
+    int cls;                // 所属大小类，-1表示缓冲池用完时临时malloc的
+    struct PacketBuf *next; // 空闲链表
+} PacketBuf;
+
+// 预先分配所有大小类的缓冲区，threads为会分配或归还缓冲区的线程数上限，须在创建线程之前调用
+// 每个大小类按各线程本地缓存都占满之后仍留有PACKET_SMALL_COUNT个来分配
+void initPacketPool(int threads);
+
+// 取一个容量不小于size的缓冲区，缓冲池用完时临时malloc，不会返回NULL（内存耗尽除外）
+PacketBuf *allocPacket(int size);
+
+// 归还缓冲区，可以由与分配者不同的线程调用；先放进本线程的本地缓存，缓存满了一次还一半给全局链表
+void freePacket(PacketBuf *p);
+
+// 把本线程本地缓存的空闲缓冲区全部还给全局链表，线程空闲挂起之前调用，
+// 只归还不分配的线程（工作线程）的缓存不会一直占着缓冲区
+void releasePackets();
+
+#endif
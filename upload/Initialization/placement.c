@@ -0,0 +1,88 @@
+#include "placement.h"
+#include "debug.h"
+
+int receiver_cpus[MAX_PLACEMENT_CPUS];
+int receiver_cpu_count = 0;
+int worker_cpus[MAX_PLACEMENT_CPUS];
+int worker_cpu_count = 0;
+
+int parseCpuList(const char *s, int *cpus, int max)
+{
+    int n = 0;
+    while (*s)
+    {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (end == s || first < 0)
+        {
+            return -1;
+        }
+        s = end;
+        if (*s == '-')
+        {
+            last = strtol(s + 1, &end, 10);
+            if (end == s + 1 || last < first)
+            {
+                return -1;
+            }
+            s = end;
+        }
+        for (long cpu = first; cpu <= last && n < max; cpu++)
+        {
+            cpus[n++] = (int)cpu;
+        }
+        if (*s == ',')
+        {
+            s++;
+        }
+        else if (*s)
+        {
+            return -1;
+        }
+    }
+    return n;
+}
+
+int loadNicIrqCpus(const char *ifname)
+{
+    int n = my_nicIrqCpus(ifname, receiver_cpus, MAX_PLACEMENT_CPUS);
+    if (n > 0)
+    {
+        receiver_cpu_count = n;
+    }
+    return n;
+}
+
+static void bindTo(const char *role, int index, int *cpus, int count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    int cpu = cpus[index % count];
+    if (my_bindThread(cpu) != 0)
+    {
+        printf("Failed to bind %s %d to CPU %d\n", role, index, cpu);
+        return;
+    }
+    debug_print1("%s %d bound to CPU %d\n", role, index, cpu);
+}
+
+void bindReceiver(int index)
+{
+    bindTo("Receiver", index, receiver_cpus, receiver_cpu_count);
+}
+
+void bindWorker(int index)
+{
+    bindTo("Worker", index, worker_cpus, worker_cpu_count);
+}
+
+void unbindThread()
+{
+    if (my_unbindThread() != 0)
+    {
+        printf("Failed to unbind thread\n");
+    }
+}
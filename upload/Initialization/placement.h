@@ -0,0 +1,28 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "header.h"
+#include "platformThread.h"
+
+#define MAX_PLACEMENT_CPUS 256
+
+// 接收类线程（主接收线程、分片、事件循环）和工作线程各自的CPU集合，个数为0表示不绑定
+extern int receiver_cpus[MAX_PLACEMENT_CPUS];
+extern int receiver_cpu_count;
+extern int worker_cpus[MAX_PLACEMENT_CPUS];
+extern int worker_cpu_count;
+
+// 解析"0-3,8,10-11"形式的CPU列表，返回CPU个数，格式错误返回-1
+int parseCpuList(const char *s, int *cpus, int max);
+
+// 按网卡各收包队列中断所在的CPU设置接收线程的CPU集合，第i个接收线程对应第i个队列
+int loadNicIrqCpus(const char *ifname);
+
+// 把当前线程绑定到接收/工作CPU集合中的第index个（超出时取模），未配置集合时什么都不做
+// 线程启动后先绑定再分配自己的缓冲区和队列，内存按首次访问落在本地NUMA节点上
+void bindReceiver(int index);
+void bindWorker(int index);
+// 解除当前线程的绑定；主线程临时绑核初始化完缓冲池后调用，之后创建的线程不会继承这个绑定
+void unbindThread();
+
+#endif
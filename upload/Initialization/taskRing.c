@@ -0,0 +1,79 @@
+#include "taskRing.h"
+
+void ringInit(TaskRing *r)
+{
+    for (long i = 0; i < TASK_QUEUE_SIZE; i++)
+    {
+        r->slots[i].seq = i;
+    }
+    r->enqueue.pos = 0;
+    r->dequeue.pos = 0;
+}
+
+int ringTryEnqueue(TaskRing *r, Task *t)
+{
+    long pos = my_atomicLoad(&r->enqueue.pos);
+    TaskSlot *slot;
+    for (;;)
+    {
+        slot = &r->slots[(unsigned long)pos & (TASK_QUEUE_SIZE - 1)];
+        long diff = (long)((unsigned long)my_atomicLoad(&slot->seq) - (unsigned long)pos);
+        if (diff == 0)
+        {
+            long cur = my_atomicCas(&r->enqueue.pos, pos, (long)((unsigned long)pos + 1));
+            if (cur == pos)
+            {
+                break;
+            }
+            pos = cur;
+        }
+        else if (diff < 0)
+        {
+            return 0; // 队列满
+        }
+        else
+        {
+            pos = my_atomicLoad(&r->enqueue.pos);
+        }
+    }
+    slot->task = *t;
+    my_atomicStore(&slot->seq, (long)((unsigned long)pos + 1));
+    return 1;
+}
+
+int ringTryDequeue(TaskRing *r, Task *t)
+{
+    long pos = my_atomicLoad(&r->dequeue.pos);
+    TaskSlot *slot;
+    for (;;)
+    {
+        slot = &r->slots[(unsigned long)pos & (TASK_QUEUE_SIZE - 1)];
+        long diff = (long)((unsigned long)my_atomicLoad(&slot->seq) - (unsigned long)pos - 1);
+        if (diff == 0)
+        {
+            long cur = my_atomicCas(&r->dequeue.pos, pos, (long)((unsigned long)pos + 1));
+            if (cur == pos)
+            {
+                break;
+            }
+            pos = cur;
+        }
+        else if (diff < 0)
+        {
+            return 0; // 队列空
+        }
+        else
+        {
+            pos = my_atomicLoad(&r->dequeue.pos);
+        }
+    }
+    *t = slot->task;
+    my_atomicStore(&slot->seq, (long)((unsigned long)pos + TASK_QUEUE_SIZE));
+    return 1;
+}
+
+int ringDepth(TaskRing *r)
+{
+    long depth = (long)((unsigned long)r->enqueue.pos - (unsigned long)r->dequeue.pos);
+    return depth < 0 ? 0 : (int)depth;
+}
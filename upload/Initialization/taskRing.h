@@ -0,0 +1,37 @@
+#ifndef TASKRING_H
+#define TASKRING_H
+
+#include "multiThread.h"
+
+// 任务环形队列，按槽位序号实现的有界多生产者多消费者无锁队列
+// 槽位seq等于pos时可写入，等于pos+1时可读出，读出后置为pos+TASK_QUEUE_SIZE留给下一圈
+// 序号按无符号回绕计算，32位long跑满一圈也不出错
+typedef struct
+{
+    volatile long seq;
+    Task task;
+} TaskSlot;
+
+typedef struct
+{
+    volatile long pos;
+    char pad[CACHE_LINE - sizeof(long)];
+} RingCursor;
+
+typedef struct
+{
+    // 入队和出队位置分开放在不同缓存行，生产者和消费者互不干扰
+    RingCursor enqueue;
+    RingCursor dequeue;
+    TaskSlot slots[TASK_QUEUE_SIZE];
+} TaskRing;
+
+void ringInit(TaskRing *r);
+// 队列满时返回0
+int ringTryEnqueue(TaskRing *r, Task *t);
+// 队列空时返回0
+int ringTryDequeue(TaskRing *r, Task *t);
+// 队列中的任务数，并发修改时只是近似值
+int ringDepth(TaskRing *r);
+
+#endif
@@ -0,0 +1,71 @@
+#include "xdpPath.h"
+
+const char *xdp_interface = NULL;
+int xdp_queue = 0;
+
+int initXdpPath(XdpPath *path, void (*handler)(Task *), int (*answer)(uint8_t *, int, int))
+{
+    path->handler = handler;
+    path->answer = answer;
+    path->xdp = my_createXdp(xdp_interface, xdp_queue, servSockAddr.sin_addr.s_addr);
+    return path->xdp ? 0 : -1;
+}
+
+static int onXdpPacket(void *arg, char *buf, int len, int size, struct sockaddr_in *addr)
+{
+    XdpPath *path = (XdpPath *)arg;
+    stats_add(&stats.xdp_packets, 1);
+
+    // 帧里能写将近2000字节，但没有EDNS的UDP应答不能超过512字节，和接收线程一样按MAX_DNS_SIZE截断并置TC
+    int reply = path->answer((uint8_t *)buf, len, size < MAX_DNS_SIZE ? size : MAX_DNS_SIZE);
+    if (reply > 0)
+    {
+        stats_add(&stats.xdp_answers, 1);
+        return reply;
+    }
+
+    // 帧要马上还给内核，报文拷到缓冲池里再按普通路径处理，回包走servSock
+    if (len > SIZE)
+    {
+        return 0;
+    }
+    Task t;
+    t.pkt = allocPacket(SIZE);
+    t.buf = t.pkt->data;
+    t.len = len;
+    memcpy(t.buf, buf, len);
+    t.clientAddr = *addr;
+    t.clientAddrLen = sizeof(t.clientAddr);
+    t.sock = servSock;
+    t.upstreamSock = servSock;
+    t.upstreamAddr = &remoteSockAddr;
+    debug_print2("Receive %d bytes from %s:%d via AF_XDP\n", t.len,
+                 inet_ntoa(t.clientAddr.sin_addr), ntohs(t.clientAddr.sin_port));
+
+    if (worker_count > 0)
+    {
+        addTask(&t);
+        return 0;
+    }
+    if (!rejectTask(&t))
+    {
+        path->handler(&t);
+    }
+    freePacket(t.pkt);
+    return 0;
+}
+
+void *xdpThread(void *lpParam)
+{
+    XdpPath *path = (XdpPath *)lpParam;
+    for (;;)
+    {
+        if (my_xdpWait(path->xdp, onXdpPacket, path, -1) < 0)
+        {
+            perror("AF_XDP poll");
+            my_sleep(1);
+        }
+        flushPackets();
+    }
+    return NULL;
+}
@@ -0,0 +1,25 @@
+#ifndef XDPPATH_H
+#define XDPPATH_H
+
+#include "multiThread.h"
+#include "platformXdp.h"
+
+// AF_XDP快速通道：在UMEM帧里直接回答能由answer处理的查询，其余报文拷进缓冲池，
+// 有线程池时交给任务队列，否则在本线程调用handler处理，和普通socket收到的报文走同样的流程
+typedef struct
+{
+    my_xdp *xdp;
+    void (*handler)(Task *);
+    int (*answer)(uint8_t *buf, int len, int size); // 原地改写成应答并返回长度，不能回答时返回0
+} XdpPath;
+
+extern const char *xdp_interface; // 挂XDP程序的网卡，NULL表示不启用
+extern int xdp_queue;             // 绑定的收包队列号
+
+// 创建AF_XDP通道，成功返回0，失败时返回-1且errno为原因
+int initXdpPath(XdpPath *path, void (*handler)(Task *), int (*answer)(uint8_t *, int, int));
+
+// AF_XDP通道线程，参数为XdpPath*，不返回
+void *xdpThread(void *lpParam);
+
+#endif
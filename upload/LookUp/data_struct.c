@@ -1,4 +1,6 @@
 #include "data_struct.h"
+#include "dns_message.h"
+#include "platformProcess.h"
 #include <ctype.h>
 
 // 全局变量定义
@@ -6,13 +8,14 @@ lru_node *hash_table[HASH_SIZE];
 lru_node *lru_head = NULL;
 lru_node *lru_tail = NULL;
 int cache_size = 0;
+static const host_table *shared_hosts = NULL;
 
 // =============================================================================
 // IP链表管理辅助函数
 // =============================================================================
 
-// 创建IP节点
-ip_node *create_ip_node(uint8_t ip[4])
+// 创建IP节点，expire为绝对过期时间，静态记录为TTL_STATIC
+ip_node *create_ip_node(uint8_t ip[4], uint32_t expire)
 {
     ip_node *node = malloc(sizeof(ip_node));
     if (!node)
@@ -21,6 +24,7 @@ ip_node *create_ip_node(uint8_t ip[4])
     }
 
     memcpy(node->ip, ip, 4);
+    node->ttl = expire;
     node->next = NULL;
     return node;
 }
@@ -39,21 +43,22 @@ void free_ip_list(ip_node *head)
 // 添加IP到链表（避免重复）
 void add_ip_to_list(ip_node **head, uint8_t ip[4], uint32_t ttl)
 {
+    uint32_t expire = ttl == TTL_STATIC ? TTL_STATIC : (uint32_t)(ttl + time(NULL));
+
     // 检查是否已存在
     ip_node *current = *head;
     while (current)
     {
         if (memcmp(current->ip, ip, 4) == 0)
         {
-            time_t now = time(NULL);
-            current->ttl = ttl + now; // 更新TTL
-            return;                   // IP已存在，不重复添加
+            current->ttl = expire; // 更新TTL
+            return;                // IP已存在，不重复添加
         }
         current = current->next;
     }
 
     // 创建新节点并添加到头部
-    ip_node *new_node = create_ip_node(ip);
+    ip_node *new_node = create_ip_node(ip, expire);
     if (new_node)
     {
         new_node->next = *head;
@@ -61,53 +66,188 @@ void add_ip_to_list(ip_node **head, uint8_t ip[4], uint32_t ttl)
     }
 }
 
-// 从IP链表获取所有IP地址
-int get_ip_from_list(ip_node *head, uint8_t ip_addrs[][4], int max_ips)
+// 按ip_list重新生成预编码的答案部分，ip_list、timestamp、ttl更新之后调用
+// 静态记录的TTL固定为TTL_SIZE；动态记录在命中时按各自的过期时间改写TTL
+static void build_answer(lru_node *node)
 {
+    free(node->answer);
+    node->answer = NULL;
+    node->answer_expire = NULL;
+    node->answer_count = 0;
+
     int count = 0;
-    ip_node *current = head;
+    for (ip_node *p = node->ip_list; p; p = p->next)
+    {
+        count++;
+    }
+    if (count == 0)
+    {
+        return;
+    }
+
+    int dynamic = node->ttl != TTL_STATIC;
+    uint8_t *block = malloc(count * (DNS_A_RECORD_SIZE + (dynamic ? sizeof(uint32_t) : 0)));
+    if (!block)
+    {
+        return; // 没有预编码答案时按未命中处理
+    }
+    node->answer = block;
+    node->answer_expire = dynamic ? (uint32_t *)(block + count * DNS_A_RECORD_SIZE) : NULL;
 
-    while (current && count < max_ips)
+    // 记录的过期时间不晚于整个节点的过期时间
+    uint32_t node_expire = (uint32_t)(node->timestamp + node->ttl);
+    int i = 0;
+    for (ip_node *p = node->ip_list; p; p = p->next, i++)
     {
-        time_t now = time(NULL);
-        if (current->ttl != TTL_STATIC && (current->ttl == 0 || now >= current->ttl))
+        set_a_record(block + i * DNS_A_RECORD_SIZE, p->ip, TTL_SIZE);
+        if (dynamic)
         {
-            // 如果TTL为0或已过期，跳过此IP
-            current = current->next;
-            continue;
+            node->answer_expire[i] = p->ttl < node_expire ? p->ttl : node_expire;
         }
-        memcpy(ip_addrs[count], current->ip, 4);
-        count++;
-        current = current->next;
     }
+    node->answer_count = count;
+}
 
-    return count;
+// 释放缓存节点和它的IP链表、预编码答案
+static void free_cache_node(lru_node *node)
+{
+    free_ip_list(node->ip_list);
+    free(node->answer);
+    free(node);
 }
 
 // =============================================================================
 // 哈希函数和双向链表操作（内部函数）
 // =============================================================================
 
-// 域名哈希函数（DJB2算法）
-// 优化的哈希函数 - 针对域名特性
-static uint32_t hash_domain(const char *domain)
+// 报文格式qname的哈希（DJB2），逐字节转小写后计算，标签长度字节也参与；out非NULL时同时写出转小写后的qname
+// 返回qname占用的字节数，含压缩指针、越界或超长时返回0
+static int hash_wire_name(const uint8_t *qname, int len, uint8_t *out, uint32_t *hash)
+{
+    uint32_t h = 5381;
+    int pos = 0;
+    while (pos < len && qname[pos] != 0)
+    {
+        int l = qname[pos];
+        if (l >= 0x40 || pos + 1 + l >= len || pos + 1 + l >= MAX_WIRE_NAME)
+        {
+            return 0; // 问题部分不应出现压缩指针
+        }
+        for (int i = pos; i <= pos + l; i++)
+        {
+            // 长度字节都小于0x40，不受转小写影响
+            uint8_t c = qname[i];
+            if (c >= 'A' && c <= 'Z')
+            {
+                c |= 0x20;
+            }
+            h = h * 33 + c;
+            if (out)
+            {
+                out[i] = c;
+            }
+        }
+        pos += l + 1;
+    }
+    if (pos >= len)
+    {
+        return 0;
+    }
+    if (out)
+    {
+        out[pos] = 0;
+    }
+    *hash = h;
+    return pos + 1;
+}
+
+static void set_key_type(cache_key *key, int qtype, int qclass)
 {
-    uint32_t hash = 0;
-    const char *p = domain;
+    key->qtype = (uint16_t)qtype;
+    key->qclass = (uint16_t)qclass;
+    key->hash = (key->name_hash * 31 + key->qtype) * 31 + key->qclass;
+}
 
-    // 跳过 www. 前缀以提高命中率
-    if (strncmp(domain, "www.", 4) == 0)
+int cache_key_from_wire(cache_key *key, const uint8_t *qname, int len, int qtype, int qclass)
+{
+    int n = hash_wire_name(qname, len, key->name, &key->name_hash);
+    if (n == 0)
     {
-        p += 4;
+        return 0;
     }
+    key->len = (uint8_t)n;
+    set_key_type(key, qtype, qclass);
+    return n;
+}
 
-    // 使用更快的哈希算法
-    while (*p)
+int cache_key_from_domain(cache_key *key, const char *domain, int qtype, int qclass)
+{
+    // 先按标签转成报文格式，跳过空标签
+    uint8_t wire[MAX_WIRE_NAME + 1];
+    int pos = 0;
+    const char *label = domain;
+    while (*label)
     {
-        hash = hash * 33 + (*p++ | 0x20); // 直接小写转换
+        const char *dot = strchr(label, '.');
+        size_t l = dot ? (size_t)(dot - label) : strlen(label);
+        if (l > 63 || pos + 1 + l >= MAX_WIRE_NAME)
+        {
+            return 0;
+        }
+        if (l > 0)
+        {
+            wire[pos++] = (uint8_t)l;
+            memcpy(wire + pos, label, l);
+            pos += l;
+        }
+        if (!dot)
+        {
+            break;
+        }
+        label = dot + 1;
     }
+    wire[pos++] = 0;
+    return cache_key_from_wire(key, wire, pos, qtype, qclass) > 0;
+}
 
-    return hash & (HASH_SIZE - 1); // 假设 HASH_SIZE 是 2 的幂
+static int key_equal(const cache_key *a, const cache_key *b)
+{
+    return a->hash == b->hash && a->len == b->len && a->qtype == b->qtype && a->qclass == b->qclass &&
+           memcmp(a->name, b->name, a->len) == 0;
+}
+
+static uint32_t hash_bucket(const cache_key *key)
+{
+    return key->hash & (HASH_SIZE - 1); // 假设 HASH_SIZE 是 2 的幂
+}
+
+// 调试输出用：把缓存键还原成点分形式
+static const char *key_name(const cache_key *key, char *buf)
+{
+    get_domain((uint8_t *)key->name, buf, (uint8_t *)key->name);
+    return buf;
+}
+
+// 存在性计数：按域名的哈希统计缓存中的表项个数（不分qtype），插入加一、移除减一（都在hash_table_Mutex内）
+// 接收线程不加锁读取，只作为“可能命中”的提示
+static volatile uint16_t presence[PRESENCE_SIZE];
+
+static void presence_add(const cache_key *key, int delta)
+{
+    presence[key->name_hash & (PRESENCE_SIZE - 1)] += delta;
+}
+
+int cache_may_contain(const uint8_t *qname, int len, int *name_len)
+{
+    // 和缓存键同一个哈希，只算不复制
+    uint32_t hash;
+    int n = hash_wire_name(qname, len, NULL, &hash);
+    if (n == 0)
+    {
+        return 0;
+    }
+    *name_len = n;
+    return presence[hash & (PRESENCE_SIZE - 1)] > 0;
 }
 
 // 从双向链表中移除节点
@@ -148,8 +288,7 @@ static void move_to_head(lru_node *node)
 // 从哈希表中移除节点
 static void remove_from_hash(lru_node *node)
 {
-    uint32_t hash = hash_domain(node->domain);
-    lru_node **hash_ptr = &hash_table[hash];
+    lru_node **hash_ptr = &hash_table[hash_bucket(&node->key)];
 
     while (*hash_ptr && *hash_ptr != node)
     {
@@ -159,6 +298,7 @@ static void remove_from_hash(lru_node *node)
     if (*hash_ptr)
     {
         *hash_ptr = node->hash_next;
+        presence_add(&node->key, -1);
     }
 }
 
@@ -171,6 +311,7 @@ void init_cache()
     // 初始化哈希表
     my_lockMutex(hash_table_Mutex);
     memset(hash_table, 0, sizeof(hash_table));
+    memset((void *)presence, 0, sizeof(presence));
 
     // 创建LRU链表的哨兵节点
     lru_head = malloc(sizeof(lru_node));
@@ -208,85 +349,279 @@ int is_cache_valid(lru_node *node)
     return (now - node->timestamp) < node->ttl;
 }
 
-int query_cache(char *domain, uint8_t ip_addrs[][4], int max_ips, int *is_authoritative)
+// 在共享静态表里找domain，只读不加锁；命中时records指向它的第一条预编码记录，没有共享表或未命中返回NULL
+static const host_entry *find_shared_host(const cache_key *key, const uint8_t **records)
 {
-    if (!lru_head || !domain || !ip_addrs)
+    // 共享表里只有静态的A记录
+    const host_table *t = shared_hosts;
+    if (!t || key->qtype != QTYPE_A || key->qclass != QCLASS_IN)
     {
-        return 0;
+        return NULL;
     }
+    const uint32_t *buckets = (const uint32_t *)(t + 1);
+    const host_entry *entries = (const host_entry *)(buckets + t->bucket_mask + 1);
+    const uint8_t *rrs = (const uint8_t *)(entries + t->count);
+    const uint8_t *names = rrs + t->ip_total * DNS_A_RECORD_SIZE;
 
-    // 计算哈希值
-    uint32_t hash = hash_domain(domain);
-    lru_node *node = hash_table[hash];
+    for (uint32_t i = buckets[key->hash & t->bucket_mask]; i != 0; i = entries[i - 1].next)
+    {
+        const host_entry *e = &entries[i - 1];
+        // 先比长度，memcmp不会读出这个表项的名字，末尾的表项也不会读出映射区
+        if (e->hash == key->hash && e->name_len == key->len && memcmp(names + e->name, key->name, key->len) == 0)
+        {
+            *records = rrs + e->ip * DNS_A_RECORD_SIZE;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+int share_static_records()
+{
+    if (!lru_head)
+    {
+        return -1;
+    }
 
-    // 先清缓存
-    // cleanup_expired_cache();
+    // 先统计静态记录的个数、IP数和域名总长，算出整块内存的大小
+    my_lockMutex(hash_table_Mutex);
+    uint32_t count = 0, ip_total = 0;
+    size_t name_bytes = 0;
+    for (lru_node *node = lru_head->next; node != lru_tail; node = node->next)
+    {
+        if (node->ttl == TTL_STATIC)
+        {
+            count++;
+            ip_total += node->ip_count;
+            name_bytes += node->key.len;
+        }
+    }
+    uint32_t buckets_count = HASH_SIZE;
+    while (buckets_count < count)
+    {
+        buckets_count <<= 1;
+    }
+    size_t size = sizeof(host_table) + buckets_count * sizeof(uint32_t) + count * sizeof(host_entry) +
+                  ip_total * DNS_A_RECORD_SIZE + name_bytes;
 
-    // 在哈希冲突链中查找
-    while (node)
+    host_table *t = my_mapShared(size);
+    if (!t)
+    {
+        my_unlockMutex(hash_table_Mutex);
+        return -1;
+    }
+    t->size = size;
+    t->bucket_mask = buckets_count - 1;
+    t->count = count;
+    t->ip_total = ip_total;
+    uint32_t *buckets = (uint32_t *)(t + 1);
+    host_entry *entries = (host_entry *)(buckets + buckets_count);
+    uint8_t *records = (uint8_t *)(entries + count);
+    uint8_t *names = records + ip_total * DNS_A_RECORD_SIZE;
+
+    // 逐个搬入共享表并从本进程缓存中删掉；存在性计数保留，入口分类仍能认出这些域名
+    uint32_t i = 0, ip = 0;
+    size_t name = 0;
+    lru_node *node = lru_head->next;
+    while (node != lru_tail)
     {
-        // lru_node *next_node = node->hash_next; // ✅ 先保存下一个节点
+        lru_node *next = node->next;
+        if (node->ttl == TTL_STATIC)
+        {
+            host_entry *e = &entries[i];
+            e->hash = node->key.hash;
+            e->name = (uint32_t)name;
+            e->name_len = node->key.len;
+            e->ip = ip;
+            e->ip_count = 0;
+            for (ip_node *p = node->ip_list; p; p = p->next)
+            {
+                set_a_record(records + ip++ * DNS_A_RECORD_SIZE, p->ip, TTL_SIZE);
+                e->ip_count++;
+            }
+            memcpy(names + name, node->key.name, node->key.len);
+            name += node->key.len;
+            e->next = buckets[e->hash & t->bucket_mask];
+            buckets[e->hash & t->bucket_mask] = ++i;
+
+            remove_from_hash(node);
+            presence_add(&node->key, 1);
+            remove_from_lru(node);
+            free_cache_node(node);
+            cache_size--;
+        }
+        node = next;
+    }
+    my_unlockMutex(hash_table_Mutex);
 
-        if (strcmp(node->domain, domain) == 0)
+    if (my_protectReadOnly(t, size) != 0)
+    {
+        debug_print1("Warning: shared host table is left writable.\n");
+    }
+    shared_hosts = t;
+    debug_print1("Shared host table: %u domain(s), %u IP(s), %zu bytes\n", count, ip_total, size);
+    return (int)count;
+}
+
+// 把count条预编码记录接到buffer+qend之后并改写头部，返回应答长度；expire为NULL表示静态记录，TTL不用改
+// 第一条记录是0.0.0.0时为被屏蔽的域名，回NXDOMAIN不带记录；动态记录全部过期时返回0
+static int copy_answer(const uint8_t *records, const uint32_t *expire, int count, int is_authoritative,
+                       int qtype, uint8_t *buffer, int qend, int size)
+{
+    static const uint8_t blocked_ip[4] = {0, 0, 0, 0};
+    if (count > 0 && memcmp(records + DNS_A_RECORD_SIZE - 4, blocked_ip, 4) == 0)
+    {
+        set_response_flags(buffer, 0, RCODE_NAME_ERROR, is_authoritative, 0);
+        return qend;
+    }
+    if (qtype != QTYPE_A)
+    {
+        return 0;
+    }
+
+    int room = (size - qend) / DNS_A_RECORD_SIZE;
+    int written = 0;
+    int tc = 0;
+    uint8_t *out = buffer + qend;
+    if (!expire)
+    {
+        written = count < room ? count : room;
+        tc = written < count;
+        memcpy(out, records, written * DNS_A_RECORD_SIZE);
+    }
+    else
+    {
+        uint32_t now = (uint32_t)time(NULL);
+        for (int i = 0; i < count; i++)
         {
-            if (!is_cache_valid(node))
+            if (expire[i] <= now)
             {
-                my_lockMutex(hash_table_Mutex);
-                remove_from_hash(node);
-                remove_from_lru(node);
-                free_ip_list(node->ip_list); // 释放IP链表
-                free(node);
+                continue;
+            }
+            if (written == room)
+            {
+                tc = 1;
+                break;
+            }
+            uint8_t *rr = out + written * DNS_A_RECORD_SIZE;
+            memcpy(rr, records + i * DNS_A_RECORD_SIZE, DNS_A_RECORD_SIZE);
+            uint32_t ttl = expire[i] - now;
+            rr[6] = (uint8_t)(ttl >> 24); // TTL在记录的第6~9字节
+            rr[7] = (uint8_t)(ttl >> 16);
+            rr[8] = (uint8_t)(ttl >> 8);
+            rr[9] = (uint8_t)ttl;
+            written++;
+        }
+        if (written == 0)
+        {
+            return 0;
+        }
+    }
 
-                cache_size--;
-                my_unlockMutex(hash_table_Mutex);
+    set_response_flags(buffer, written, RCODE_NO_ERROR, is_authoritative, tc);
+    return qend + written * DNS_A_RECORD_SIZE;
+}
 
-                debug_print1("Cache expired: %s\n", domain);
+int answer_from_cache(uint8_t *buffer, int qend, int size, int blocking)
+{
+    if (!lru_head || !buffer || qend < DNS_HEADER_SIZE + 5)
+    {
+        return 0;
+    }
 
-                return 0;
-            } // 找到有效记录，获取所有IP地址
-            my_lockMutex(hash_table_Mutex);
-            int ip_count = get_ip_from_list(node->ip_list, ip_addrs, max_ips);
-            move_to_head(node);
-            *is_authoritative = node->is_authoritative;
-            my_unlockMutex(hash_table_Mutex);
+    // 缓存里只有A记录：其他类型的查询也按同名A记录的键查，copy_answer只对被屏蔽的域名作答
+    int qtype = (buffer[qend - 4] << 8) | buffer[qend - 3];
+    int qclass = (buffer[qend - 2] << 8) | buffer[qend - 1];
+    cache_key key;
+    if (!cache_key_from_wire(&key, buffer + DNS_HEADER_SIZE, qend - 4 - DNS_HEADER_SIZE, QTYPE_A, qclass))
+    {
+        return 0;
+    }
 
-            if (debug_mode == 2)
+    const uint8_t *records;
+    const host_entry *e = find_shared_host(&key, &records);
+    if (e)
+    {
+        return copy_answer(records, NULL, (int)e->ip_count, 1, qtype, buffer, qend, size);
+    }
+
+    if (!blocking)
+    {
+        if (!my_tryLockMutex(hash_table_Mutex))
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        my_lockMutex(hash_table_Mutex);
+    }
+
+    // 整个查找和复制都在锁内
+    int len = 0;
+    for (lru_node *node = hash_table[hash_bucket(&key)]; node; node = node->hash_next)
+    {
+        if (key_equal(&node->key, &key))
+        {
+            if (is_cache_valid(node))
             {
-                debug_print2("Cache hit: %s -> %d IP(s)\n", domain, ip_count);
-                for (int i = 0; i < ip_count; i++)
+                len = copy_answer(node->answer, node->answer_expire, node->answer_count, node->is_authoritative,
+                                  qtype, buffer, qend, size);
+                move_to_head(node);
+            }
+            else if (blocking)
+            {
+                // 过期记录只由工作线程删除
+                if (debug_mode)
                 {
-                    debug_print2("  IP %d: %d.%d.%d.%d\n", i + 1,
-                                 ip_addrs[i][0], ip_addrs[i][1], ip_addrs[i][2], ip_addrs[i][3]);
+                    char name[MAX_DOMAIN_NAME_LEN];
+                    debug_print1("Cache expired: %s\n", key_name(&node->key, name));
                 }
+                remove_from_hash(node);
+                remove_from_lru(node);
+                free_cache_node(node);
+                cache_size--;
             }
-
-            return ip_count;
+            break;
         }
-        // my_lockMutex(hash_table_Mutex);
-        node = node->hash_next;
-        // my_unlockMutex(hash_table_Mutex);
     }
+    my_unlockMutex(hash_table_Mutex);
 
-    debug_print2("Cache miss: %s\n", domain);
-
-    return 0;
+    if (debug_mode == 2)
+    {
+        char name[MAX_DOMAIN_NAME_LEN];
+        debug_print2("Cache %s: %s\n", len ? "hit" : "miss", key_name(&key, name));
+    }
+    return len;
 }
 
-void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, char *domain, int is_authoritative)
+void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, const cache_key *key, int is_authoritative)
 {
-    if (!lru_head || !domain || !ip_addrs || ip_count <= 0)
+    if (!lru_head || !key || !ip_addrs || ip_count <= 0)
     {
         return;
     }
 
-    uint32_t hash = hash_domain(domain);
+    uint32_t hash = hash_bucket(key);
     lru_node *node = hash_table[hash];
+    char domain[MAX_DOMAIN_NAME_LEN] = "";
+    if (debug_mode == 2)
+    {
+        key_name(key, domain);
+    }
 
     // 检查是否已存在
     while (node)
     {
-        if (strcmp(node->domain, domain) == 0)
+        if (key_equal(&node->key, key))
         {
+            // 静态记录以hosts文件为准，不被上游应答覆盖
+            if (node->ttl == TTL_STATIC)
+            {
+                debug_print2("Cache update skipped for static record: %s\n", domain);
+                return;
+            }
+
             // 更新现有节点，替换整个IP链表
             my_lockMutex(hash_table_Mutex);
 
@@ -305,6 +640,7 @@ void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, char *doma
             node->timestamp = time(NULL);
             node->ttl = TTL_SIZE;
             node->is_authoritative = 0; // 更新权威性
+            build_answer(node);
             // move_to_head(node);
             my_unlockMutex(hash_table_Mutex);
 
@@ -341,11 +677,12 @@ void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, char *doma
         add_ip_to_list(&(new_node->ip_list), ip_addrs[i], ttl[i]);
         new_node->ip_count++;
     }
-    strncpy(new_node->domain, domain, MAX_SIZE - 1);
-    new_node->domain[MAX_SIZE - 1] = '\0';
+    new_node->key = *key;
     new_node->timestamp = time(NULL);
     new_node->ttl = TTL_SIZE;
     new_node->is_authoritative = 0; // 设置权威性
+    new_node->answer = NULL;
+    build_answer(new_node);
     new_node->prev = NULL;
     new_node->next = NULL;
     new_node->hash_next = NULL;
@@ -354,6 +691,7 @@ void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, char *doma
     my_lockMutex(hash_table_Mutex);
     new_node->hash_next = hash_table[hash];
     hash_table[hash] = new_node;
+    presence_add(&new_node->key, 1);
     add_to_head(new_node);
     cache_size++;
     my_unlockMutex(hash_table_Mutex);
@@ -395,15 +733,18 @@ void delete_cache()
         tail_node = tail_node->prev; // 获取下一个节点
     }
 
-    debug_print1("Cache evicted: %s\n", tail_node->domain);
+    if (debug_mode)
+    {
+        char name[MAX_DOMAIN_NAME_LEN];
+        debug_print1("Cache evicted: %s\n", key_name(&tail_node->key, name));
+    }
 
     // 从哈希表中移除
     remove_from_hash(tail_node); // 从LRU链表中移除
     remove_from_lru(tail_node);
 
     // 释放IP链表和节点内存
-    free_ip_list(tail_node->ip_list);
-    free(tail_node);
+    free_cache_node(tail_node);
     cache_size--;
 }
 
@@ -423,13 +764,15 @@ void cleanup_expired_cache()
 
         if (!is_cache_valid(current))
         {
-
-            debug_print1("Cleaning expired cache: %s\n", current->domain);
+            if (debug_mode)
+            {
+                char name[MAX_DOMAIN_NAME_LEN];
+                debug_print1("Cleaning expired cache: %s\n", key_name(&current->key, name));
+            }
 
             remove_from_hash(current);
             remove_from_lru(current);
-            free_ip_list(current->ip_list); // 释放IP链表
-            free(current);
+            free_cache_node(current);
             cache_size--;
         }
 
@@ -446,13 +789,20 @@ void add_static_record(uint8_t ip_addr[4], char *domain)
         return;
     }
 
-    uint32_t hash = hash_domain(domain);
+    // hosts文件里的记录都按A、IN类型的键存放
+    cache_key key;
+    if (!cache_key_from_domain(&key, domain, QTYPE_A, QCLASS_IN))
+    {
+        debug_print1("Invalid domain in host file: %s\n", domain);
+        return;
+    }
+    uint32_t hash = hash_bucket(&key);
     lru_node *node = hash_table[hash];
 
     // 检查是否已存在
     while (node)
     {
-        if (strcmp(node->domain, domain) == 0)
+        if (key_equal(&node->key, &key))
         {
             // 更新现有节点为静态记录，添加IP到链表
             my_lockMutex(hash_table_Mutex);
@@ -461,6 +811,7 @@ void add_static_record(uint8_t ip_addr[4], char *domain)
             node->timestamp = time(NULL);
             node->ttl = TTL_STATIC;     // 静态记录永不过期
             node->is_authoritative = 1; // 静态记录总是权威的
+            build_answer(node);
             my_unlockMutex(hash_table_Mutex);
 
             debug_print2("Static record updated: %s -> %d.%d.%d.%d (total: %d IPs)\n",
@@ -478,13 +829,14 @@ void add_static_record(uint8_t ip_addr[4], char *domain)
         debug_print1("Error: Failed to allocate memory for static record.\n");
         return;
     } // 设置节点数据
-    new_node->ip_list = create_ip_node(ip_addr); // 创建IP链表
+    new_node->ip_list = create_ip_node(ip_addr, TTL_STATIC); // 创建IP链表
     new_node->ip_count = 1;
-    strncpy(new_node->domain, domain, MAX_SIZE - 1);
-    new_node->domain[MAX_SIZE - 1] = '\0';
+    new_node->key = key;
     new_node->timestamp = time(NULL);
     new_node->ttl = TTL_STATIC;     // 静态记录永不过期
     new_node->is_authoritative = 1; // 静态记录总是权威的
+    new_node->answer = NULL;
+    build_answer(new_node);
     new_node->prev = NULL;
     new_node->next = NULL;
     new_node->hash_next = NULL;
@@ -493,6 +845,7 @@ void add_static_record(uint8_t ip_addr[4], char *domain)
     my_lockMutex(hash_table_Mutex);
     new_node->hash_next = hash_table[hash];
     hash_table[hash] = new_node;
+    presence_add(&new_node->key, 1);
 
     // 静态记录不参与LRU，但为了保持一致性，仍然加入链表
     add_to_head(new_node);
@@ -577,7 +930,8 @@ void print_cache_stats()
     int count = 0;
     while (node != lru_tail && count < 5)
     {
-        printf("  %s -> ", node->domain);
+        char name[MAX_DOMAIN_NAME_LEN];
+        printf("  %s -> ", key_name(&node->key, name));
         if (node->ip_list)
         {
             ip_node *ip_current = node->ip_list;
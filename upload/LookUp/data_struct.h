@@ -11,6 +11,8 @@
 #define HASH_SIZE 1024
 #define TTL_SIZE 300          // 默认TTL为300秒（5分钟）
 #define TTL_STATIC 0xFFFFFFFF // 静态记录标识（永不过期）
+#define PRESENCE_SIZE 65536   // 存在性计数表大小，必须是2的幂
+#define MAX_WIRE_NAME 255     // 报文格式域名的最大长度（含结尾的0）
 
 // 全局变量声明
 extern char IPAddr[MAX_SIZE];
@@ -25,20 +27,56 @@ typedef struct ip_node
     struct ip_node *next; // 指向下一个IP
 } ip_node;
 
+// 缓存键：报文格式的qname（ASCII字母转成小写）加上qtype、qclass，直接从报文字节构造，不经过点分字符串
+// 标签长度字节也参与比较和哈希，"a.bc"和"ab.c"不会混淆
+typedef struct
+{
+    uint8_t name[MAX_WIRE_NAME];
+    uint8_t len;        // name的字节数（含结尾的0）
+    uint16_t qtype;
+    uint16_t qclass;
+    uint32_t name_hash; // 只按name计算的哈希，存在性计数用
+    uint32_t hash;      // name_hash混入qtype、qclass，哈希表用
+} cache_key;
+
 /* 优化的LRU缓存结构体 - 双向链表 + 哈希表 + 多IP支持 */
 typedef struct cache_node
 {
     ip_node *ip_list;             // IP地址链表（支持多个IP）
     int ip_count;                 // IP地址数量
-    char domain[MAX_SIZE];        // 域名
+    cache_key key;                // 缓存键
     time_t timestamp;             // 时间戳
     uint32_t ttl;                 // 生存时间
     int is_authoritative;         // 权威性标识
+    uint8_t *answer;              // 预编码的答案部分：answer_count条A记录，顺序和ip_list一致，命中时直接复制进应答
+    uint32_t *answer_expire;      // 每条记录的绝对过期时间（和answer同一块内存），静态记录为NULL
+    int answer_count;
     struct cache_node *prev;      // 前驱节点
     struct cache_node *next;      // 后继节点
     struct cache_node *hash_next; // 哈希冲突链表
 } lru_node;
 
+// 共享静态表：read_host读入的静态记录整体搬到一块只读共享内存，fork出的各进程共用一份
+// 整块内存依次为头部、桶数组、表项数组、答案记录数组和名字区，内部只用下标和偏移，不含指针
+// 每个IP存一条预编码的A记录（DNS_A_RECORD_SIZE字节），IP就在记录的最后4字节
+typedef struct
+{
+    uint32_t hash;     // 域名的完整哈希值
+    uint32_t next;     // 同一个桶里下一个表项的下标+1，0表示没有
+    uint32_t name;     // 报文格式域名（已转小写）在名字区的偏移
+    uint32_t name_len; // 域名的字节数（含结尾的0）
+    uint32_t ip;       // 第一条记录在答案记录数组中的下标
+    uint32_t ip_count; // IP个数
+} host_entry;
+
+typedef struct
+{
+    size_t size;          // 整块内存的字节数
+    uint32_t bucket_mask; // 桶数-1，桶数是2的幂
+    uint32_t count;       // 表项数
+    uint32_t ip_total;    // IP总数
+} host_table;
+
 // 全局变量声明
 extern lru_node *hash_table[HASH_SIZE];
 extern lru_node *lru_head;
@@ -48,13 +86,27 @@ extern int cache_size;
 // 函数声明
 // 缓存管理
 void init_cache();
-int query_cache(char *domain, uint8_t ip_addrs[][4], int max_ips, int *is_authoritative); // 修改：支持多个IP地址
+// 按查询报文的问题直接查缓存，命中时把预编码答案接在问题之后，改写头部，返回应答长度；未命中返回0
+// qend为问题结束的位置，size为缓冲区大小，放不下的记录截掉并置TC；动态记录的TTL改为剩余秒数
+// 缓存里只有A记录，qtype不是A时只回答被屏蔽的域名（NXDOMAIN）
+// blocking为0时（接收线程）锁被占用也返回0，且不删除过期记录
+int answer_from_cache(uint8_t *buffer, int qend, int size, int blocking);
+// 从报文中的qname构造缓存键，qname不能含压缩指针，len为可读的字节数；返回qname占用的字节数，格式不对返回0
+int cache_key_from_wire(cache_key *key, const uint8_t *qname, int len, int qtype, int qclass);
+// 从点分形式的域名构造缓存键（hosts文件等不是报文的来源），成功返回1
+int cache_key_from_domain(cache_key *key, const char *domain, int qtype, int qclass);
+// 把缓存中的静态记录移到共享静态表，之后查询先查共享表；成功返回表项数，失败返回-1且缓存不变
+// 须在创建其他线程之前调用
+int share_static_records();
 // void update_cache(uint8_t ip_addr[4], char *domain);                        // 保持单IP更新接口
-void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, char *domain, int is_authoritative); // 新增：多IP更新接口，包含权威性
+void update_cache(uint8_t ip_addrs[][4], int ip_count, uint32_t *ttl, const cache_key *key, int is_authoritative); // 新增：多IP更新接口，包含权威性；不覆盖静态记录
 void add_static_record(uint8_t ip_addr[4], char *domain);                                                  // 新增：添加静态记录
 void delete_cache();
 void cleanup_expired_cache();
 int is_cache_valid(lru_node *node);
+// 报文中的qname（标签序列）是否可能在缓存中，不加锁，只作提示；name_len返回qname占用的字节数
+// qname格式不对时返回0且不写name_len
+int cache_may_contain(const uint8_t *qname, int len, int *name_len);
 
 // 辅助函数
 void transfer_IP(uint8_t *this_IP, char *IP_addr);
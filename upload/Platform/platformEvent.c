@@ -0,0 +1,238 @@
+#include "platformEvent.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+struct my_poller
+{
+    my_socket socks[MY_POLLER_MAX];
+    int count;
+};
+
+my_poller* my_createPoller()
+{
+    my_poller* p = (my_poller*)malloc(sizeof(my_poller));
+    if (p) {
+        p->count = 0;
+    }
+    return p;
+}
+void my_destroyPoller(my_poller* p)
+{
+    free(p);
+}
+
+int my_pollerAdd(my_poller* p, my_socket s)
+{
+    if (p->count >= MY_POLLER_MAX) {
+        return -1;
+    }
+    p->socks[p->count++] = s;
+    return 0;
+}
+
+int my_pollerWait(my_poller* p, my_socket* ready, int max, int timeout)
+{
+    fd_set readSet;
+    struct timeval tv;
+    FD_ZERO(&readSet);
+    for (int i = 0; i < p->count; i++) {
+        FD_SET(p->socks[i], &readSet);
+    }
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+    int ret = select(0, &readSet, NULL, NULL, timeout < 0 ? NULL : &tv);
+    if (ret <= 0) {
+        return ret;
+    }
+    int n = 0;
+    for (int i = 0; i < p->count && n < max; i++) {
+        if (FD_ISSET(p->socks[i], &readSet)) {
+            ready[n++] = p->socks[i];
+        }
+    }
+    return n;
+}
+
+struct my_waiter
+{
+    my_semaphore* sem;
+    WSAEVENT sockEvent;
+};
+
+my_waiter* my_createWaiter(my_semaphore* sem, my_socket s)
+{
+    my_waiter* w = (my_waiter*)malloc(sizeof(my_waiter));
+    if (!w) {
+        return NULL;
+    }
+    w->sem = sem;
+    w->sockEvent = WSACreateEvent();
+    // WSAEventSelect会顺带把socket设为非阻塞
+    if (w->sockEvent == WSA_INVALID_EVENT || WSAEventSelect(s, w->sockEvent, FD_READ) != 0) {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+void my_destroyWaiter(my_waiter* w)
+{
+    if (w) {
+        WSACloseEvent(w->sockEvent);
+        free(w);
+    }
+}
+
+int my_waiterWait(my_waiter* w)
+{
+    // 数组中socket事件在前，两者都就绪时返回下标较小的一个
+    HANDLE handles[2] = { w->sockEvent, *w->sem };
+    DWORD ret = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    if (ret == WAIT_OBJECT_0) {
+        WSAResetEvent(w->sockEvent);
+        return 0;
+    }
+    if (ret == WAIT_OBJECT_0 + 1) {
+        return 1;
+    }
+    return -1;
+}
+
+#else
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct my_poller
+{
+    int epfd;
+};
+
+my_poller* my_createPoller()
+{
+    my_poller* p = (my_poller*)malloc(sizeof(my_poller));
+    if (p) {
+        p->epfd = epoll_create1(0);
+        if (p->epfd < 0) {
+            free(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+void my_destroyPoller(my_poller* p)
+{
+    if (p) {
+        close(p->epfd);
+        free(p);
+    }
+}
+
+int my_pollerAdd(my_poller* p, my_socket s)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = s;
+
+    // 多个事件循环共享同一个socket时，EPOLLEXCLUSIVE避免一个报文唤醒所有线程
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, s, &ev) == 0) {
+        return 0;
+    }
+    // 老内核不支持EPOLLEXCLUSIVE
+    ev.events = EPOLLIN;
+    return epoll_ctl(p->epfd, EPOLL_CTL_ADD, s, &ev);
+}
+
+int my_pollerWait(my_poller* p, my_socket* ready, int max, int timeout)
+{
+    struct epoll_event events[MY_POLLER_MAX];
+    if (max > MY_POLLER_MAX) {
+        max = MY_POLLER_MAX;
+    }
+
+    int n = epoll_wait(p->epfd, events, max, timeout);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < n; i++) {
+        ready[i] = events[i].data.fd;
+    }
+    return n;
+}
+
+struct my_waiter
+{
+    my_semaphore* sem;
+    my_socket sock;
+    int epfd;
+};
+
+my_waiter* my_createWaiter(my_semaphore* sem, my_socket s)
+{
+    struct epoll_event ev;
+    my_waiter* w = (my_waiter*)malloc(sizeof(my_waiter));
+    if (!w) {
+        return NULL;
+    }
+    w->sem = sem;
+    w->sock = s;
+    w->epfd = epoll_create1(0);
+    if (w->epfd < 0 || sem->efd < 0 || my_setNonBlocking(s) != 0) {
+        my_destroyWaiter(w);
+        return NULL;
+    }
+
+    // 多个线程等同一个信号量，EPOLLEXCLUSIVE保证每次post只唤醒一个
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = sem->efd;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, sem->efd, &ev) != 0) {
+        ev.events = EPOLLIN;
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, sem->efd, &ev);
+    }
+    ev.data.fd = s;
+    ev.events = EPOLLIN;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, s, &ev) != 0) {
+        my_destroyWaiter(w);
+        return NULL;
+    }
+    return w;
+}
+void my_destroyWaiter(my_waiter* w)
+{
+    if (w) {
+        if (w->epfd >= 0) {
+            close(w->epfd);
+        }
+        free(w);
+    }
+}
+
+int my_waiterWait(my_waiter* w)
+{
+    struct epoll_event events[2];
+    for (;;) {
+        int n = epoll_wait(w->epfd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == w->sock) {
+                return 0;
+            }
+        }
+        // 信号量可读，但可能被别的线程抢先拿走，拿不到就继续等
+        if (my_tryWaitSemaphore(w->sem)) {
+            return 1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PLATFORMEVENT_H
+#define PLATFORMEVENT_H
+
+#include "platformSocket.h"
+#include "platformThread.h"
+
+// 单个poller最多监听的socket数
+#define MY_POLLER_MAX 64
+
+// 可读事件等待器：Linux下为epoll，Windows下退化为select
+typedef struct my_poller my_poller;
+
+my_poller* my_createPoller();
+void my_destroyPoller(my_poller* p);
+
+// 监听socket的可读事件，成功返回0
+int my_pollerAdd(my_poller* p, my_socket s);
+
+// 等待可读事件，把可读的socket写入ready，返回个数；timeout为毫秒，-1表示一直等
+int my_pollerWait(my_poller* p, my_socket* ready, int max, int timeout);
+
+// 同时等待信号量和一个socket，每个线程一个
+// 信号量须由my_createPollableSemaphore创建；socket会被设为非阻塞
+typedef struct my_waiter my_waiter;
+
+my_waiter* my_createWaiter(my_semaphore* sem, my_socket s);
+void my_destroyWaiter(my_waiter* w);
+
+// 阻塞到拿到信号量（返回1）或socket可读（返回0），两者都就绪时优先报告socket，出错返回-1
+int my_waiterWait(my_waiter* w);
+
+#endif
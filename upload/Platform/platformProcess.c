@@ -0,0 +1,108 @@
+#include "platformProcess.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+void* my_mapShared(size_t size)
+{
+    // Windows没有fork，这块内存只在本进程里用，和Linux保持同样的接口
+    HANDLE h = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                 (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+    if (!h) {
+        return NULL;
+    }
+    void* p = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(h); // 映射视图会保持映射对象存活
+    return p;
+}
+
+int my_protectReadOnly(void* p, size_t size)
+{
+    DWORD old;
+    return VirtualProtect(p, size, PAGE_READONLY, &old) ? 0 : -1;
+}
+
+int my_spawnWorkers(int n)
+{
+    (void)n;
+    return -1;
+}
+
+#else
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void* my_mapShared(size_t size)
+{
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+int my_protectReadOnly(void* p, size_t size)
+{
+    return mprotect(p, size, PROT_READ);
+}
+
+// 返回子进程pid，子进程里返回0
+static pid_t spawn(int index)
+{
+    fflush(stdout); // 避免缓冲区里没输出的内容被子进程再输出一遍
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 监督进程退出时子进程跟着退出，不留下占着端口的孤儿
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        return 0;
+    }
+    if (pid < 0) {
+        perror("fork");
+    } else {
+        printf("Worker process %d started (pid %d)\n", index, (int)pid);
+    }
+    return pid;
+}
+
+int my_spawnWorkers(int n)
+{
+    pid_t* pids = (pid_t*)calloc(n, sizeof(pid_t));
+    if (!pids) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if ((pids[i] = spawn(i)) == 0) {
+            free(pids);
+            return i;
+        }
+    }
+
+    for (;;) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            sleep(1);
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (pids[i] != pid) {
+                continue;
+            }
+            if (WIFSIGNALED(status)) {
+                printf("Worker process %d (pid %d) killed by signal %d, restarting\n", i, (int)pid, WTERMSIG(status));
+            } else {
+                printf("Worker process %d (pid %d) exited with %d, restarting\n", i, (int)pid, WEXITSTATUS(status));
+            }
+            fflush(stdout);
+            sleep(1);
+            if ((pids[i] = spawn(i)) == 0) {
+                free(pids);
+                return i;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef PLATFORMPROCESS_H
+#define PLATFORMPROCESS_H
+
+#include "header.h"
+
+// 分配一块可被fork出的子进程共享的匿名内存，失败返回NULL
+void* my_mapShared(size_t size);
+
+// 把共享内存设为只读，之后任何进程写入都会直接崩溃，成功返回0
+int my_protectReadOnly(void* p, size_t size);
+
+// fork出n个工作进程，子进程里返回自己的编号0..n-1
+// 父进程留下来做监督：子进程退出后隔一秒重新拉起同编号的进程，不会返回
+// 不支持fork的平台直接返回-1，由调用方退回单进程
+int my_spawnWorkers(int n);
+
+#endif
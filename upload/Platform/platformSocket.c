@@ -1,4 +1,6 @@
 #include "platformSocket.h"
+#include <stdlib.h>
+#include <string.h>
 #ifdef _WIN32
 
 void my_setSockAddr(struct sockaddr_in* sockaddr, short family, u_long addr, u_short port) {
@@ -19,11 +21,204 @@ void my_socketRelease()
     WSACleanup();
 }
 
+void my_closeSocket(my_socket s)
+{
+    closesocket(s);
+}
+
+// Windows没有SO_REUSEPORT（SO_REUSEADDR语义不同，不能用于分流）
+int my_setReusePort(my_socket s)
+{
+    (void)s;
+    return -1;
+}
+
+int my_steerReusePort(my_socket s, int sockets)
+{
+    (void)s;
+    (void)sockets;
+    return -1;
+}
+
+int my_setNonBlocking(my_socket s)
+{
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on);
+}
+
+int my_socketWouldBlock()
+{
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+int my_recvBatch(my_socket s, my_packet* pkts, int n)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    int addrLen = sizeof(struct sockaddr_in);
+    int len = recvfrom(s, pkts[0].buf, pkts[0].size, 0, (struct sockaddr*)pkts[0].addr, &addrLen);
+    if (len < 0) {
+        return -1;
+    }
+    pkts[0].len = len;
+    return 1;
+}
+
+int my_sendBatch(my_socket s, my_packet* pkts, int n)
+{
+    int sent = 0;
+    for (int i = 0; i < n; i++) {
+        int addrLen = pkts[i].addr ? sizeof(struct sockaddr_in) : 0;
+        if (sendto(s, pkts[i].buf, pkts[i].len, 0, (struct sockaddr*)pkts[i].addr, addrLen) < 0) {
+            return sent > 0 ? sent : -1;
+        }
+        sent++;
+    }
+    return sent;
+}
+
 #else
 
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/filter.h>
+
 void my_setSockAddr(struct sockaddr_in* sockaddr, short family, u_long addr, u_short port) {
     sockaddr->sin_family = family;
     sockaddr->sin_addr.s_addr = addr;
     sockaddr->sin_port = htons(port);
 }
+
+void my_closeSocket(my_socket s)
+{
+    close(s);
+}
+
+int my_setReusePort(my_socket s)
+{
+    int on = 1;
+    return setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+}
+
+// 域名最多255字节，每个字节展开成STEER_BYTE_INSNS条指令，加上首尾共约3.1K条，不超过BPF_MAXINSNS
+#define STEER_NAME_BYTES 255
+#define STEER_BYTE_INSNS 12
+
+int my_steerReusePort(my_socket s, int sockets)
+{
+    if (sockets < 1) {
+        return -1;
+    }
+    // 内核在运行程序前去掉了UDP头部，偏移0就是DNS头部，域名从偏移12开始
+    // M[0]存哈希值，M[1]存报文长度；cBPF只能向前跳，所以逐字节展开：
+    // 超出报文长度或遇到结束的0字节就跳到末尾，否则 hash = hash * 33 + (byte | 0x20)
+    int count = 4 + STEER_NAME_BYTES * STEER_BYTE_INSNS + 3;
+    struct sock_filter* code = (struct sock_filter*)malloc(sizeof(struct sock_filter) * count);
+    if (!code) {
+        return -1;
+    }
+    int n = 0;
+    int end = count - 3;
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_ST, 1);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_IMM, 0);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_ST, 0);
+    for (int i = 0; i < STEER_NAME_BYTES; i++) {
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_MEM, 1);
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 12 + i, 1, 0);
+        code[n] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, end - n - 1);
+        n++;
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 12 + i);
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 1);
+        code[n] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, end - n - 1);
+        n++;
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x20);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_MEM, 0);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 33);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ST, 0);
+    }
+    // 返回值不小于组内socket数时（例如其他进程还没bind），内核退回四元组哈希
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_MEM, 0);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, sockets);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    struct sock_fprog prog = {(unsigned short)n, code};
+    int ret = setsockopt(s, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    free(code);
+    return ret;
+}
+
+int my_setNonBlocking(my_socket s)
+{
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(s, F_SETFL, flags | O_NONBLOCK);
+}
+
+int my_socketWouldBlock()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+int my_recvBatch(my_socket s, my_packet* pkts, int n)
+{
+    struct mmsghdr msgs[MY_MAX_BATCH];
+    struct iovec iovs[MY_MAX_BATCH];
+
+    if (n > MY_MAX_BATCH) {
+        n = MY_MAX_BATCH;
+    }
+    memset(msgs, 0, sizeof(struct mmsghdr) * n);
+    for (int i = 0; i < n; i++) {
+        iovs[i].iov_base = pkts[i].buf;
+        iovs[i].iov_len = pkts[i].size;
+        msgs[i].msg_hdr.msg_name = pkts[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // MSG_WAITFORONE：阻塞等到第一个报文，之后只取已经到达的报文
+    int ret = recvmmsg(s, msgs, n, MSG_WAITFORONE, NULL);
+    for (int i = 0; i < ret; i++) {
+        pkts[i].len = (int)msgs[i].msg_len;
+    }
+    return ret;
+}
+
+int my_sendBatch(my_socket s, my_packet* pkts, int n)
+{
+    struct mmsghdr msgs[MY_MAX_BATCH];
+    struct iovec iovs[MY_MAX_BATCH];
+
+    if (n > MY_MAX_BATCH) {
+        n = MY_MAX_BATCH;
+    }
+    memset(msgs, 0, sizeof(struct mmsghdr) * n);
+    for (int i = 0; i < n; i++) {
+        iovs[i].iov_base = pkts[i].buf;
+        iovs[i].iov_len = pkts[i].len;
+        msgs[i].msg_hdr.msg_name = pkts[i].addr;
+        msgs[i].msg_hdr.msg_namelen = pkts[i].addr ? sizeof(struct sockaddr_in) : 0;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // sendmmsg可能只发出一部分，剩余的继续发送
+    int sent = 0;
+    while (sent < n) {
+        int ret = sendmmsg(s, msgs + sent, n - sent, 0);
+        if (ret <= 0) {
+            return sent > 0 ? sent : -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
 #endif
\ No newline at end of file
@@ -1,7 +1,11 @@
+#ifndef PLATFORMSOCKET_H
+#define PLATFORMSOCKET_H
+
 #ifdef _WIN32
 
 #include <winsock2.h>
 typedef SOCKET my_socket;
+#define MY_INVALID_SOCKET INVALID_SOCKET
 
 void my_setSockAddr(struct sockaddr_in* sockaddr,short family,u_long addr,u_short port);
 void my_socketInit();
@@ -17,6 +21,45 @@ void my_socketRelease();
 #define my_socketRelease();
 
 typedef int my_socket;
+#define MY_INVALID_SOCKET (-1)
 void my_setSockAddr(struct sockaddr_in* sockaddr,short family,u_long addr,u_short port);
 
-#endif
\ No newline at end of file
+#endif
+
+void my_closeSocket(my_socket s);
+
+// 为socket开启SO_REUSEPORT，须在bind之前调用，成功返回0，不支持时返回-1
+int my_setReusePort(my_socket s);
+
+// 在s所在的SO_REUSEPORT组上挂一个cBPF程序，按DNS问题中的域名（不区分大小写）选择socket，
+// 同一个域名总是落到同一个socket；sockets为组内socket总数，须在bind之后调用
+// 成功返回0，不支持时返回-1，内核继续按四元组哈希分配
+int my_steerReusePort(my_socket s, int sockets);
+
+// 设置为非阻塞socket，成功返回0
+int my_setNonBlocking(my_socket s);
+
+// 上一次socket调用是否因为非阻塞而返回（没有数据可读/缓冲区已满）
+int my_socketWouldBlock();
+
+// 单次批量收发的最大报文数
+#define MY_MAX_BATCH 64
+
+// 批量收发使用的报文描述，buf和addr由调用者提供
+typedef struct
+{
+    char* buf;                // 报文缓冲区
+    int size;                 // 缓冲区容量
+    int len;                  // 报文长度（接收时由函数填写）
+    struct sockaddr_in* addr; // 对端地址，发送时为NULL表示socket已connect
+} my_packet;
+
+// 批量接收，阻塞到至少收到一个报文，返回收到的报文数，出错返回-1
+// Linux下使用recvmmsg，其他平台退化为单次recvfrom
+int my_recvBatch(my_socket s, my_packet* pkts, int n);
+
+// 批量发送，返回成功发出的报文数，出错返回-1
+// Linux下使用sendmmsg，其他平台逐个sendto
+int my_sendBatch(my_socket s, my_packet* pkts, int n);
+
+#endif
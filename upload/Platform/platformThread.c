@@ -21,6 +21,9 @@ void my_destroyMutex(my_mutex* m)
 void my_lockMutex(my_mutex* m) {
     WaitForSingleObject(*m, INFINITE);
 }
+int my_tryLockMutex(my_mutex* m) {
+    return WaitForSingleObject(*m, 0) == WAIT_OBJECT_0;
+}
 void my_unlockMutex(my_mutex* m) {
     ReleaseMutex(*m);
 }
@@ -32,6 +35,10 @@ my_semaphore* my_createSemaphore(unsigned int initialValue, unsigned int maxValu
     }
     return s;
 }
+// Windows的信号量句柄本身就可以和socket事件一起等待
+my_semaphore* my_createPollableSemaphore(unsigned int initialValue, unsigned int maxValue) {
+    return my_createSemaphore(initialValue, maxValue);
+}
 void my_destroySemaphore(my_semaphore* s) {
     if (s) {
         CloseHandle(*s);
@@ -41,6 +48,10 @@ void my_destroySemaphore(my_semaphore* s) {
 void my_waitSemaphore(my_semaphore* s) {
     WaitForSingleObject(*s, INFINITE);
 }
+// 不阻塞地尝试获取信号量，成功返回1
+int my_tryWaitSemaphore(my_semaphore* s) {
+    return WaitForSingleObject(*s, 0) == WAIT_OBJECT_0;
+}
 void my_postSemaphore(my_semaphore* s) {
     ReleaseSemaphore(*s, 1, NULL);
 }
@@ -58,8 +69,129 @@ unsigned long my_get_thread_id() {
     return (unsigned long)GetCurrentThreadId();
 }
 
+long my_atomicAdd(volatile long* p, long value) {
+    return InterlockedExchangeAdd(p, value);
+}
+long my_atomicCas(volatile long* p, long expected, long desired) {
+    return InterlockedCompareExchange(p, desired, expected);
+}
+// Interlocked系列都是完整内存屏障，强于需要的acquire/release
+long my_atomicLoad(volatile long* p) {
+    return InterlockedCompareExchange(p, 0, 0);
+}
+void my_atomicStore(volatile long* p, long value) {
+    InterlockedExchange(p, value);
+}
+
+void my_initEvent(my_eventcount* e) {
+    e->waiters = 0;
+    e->epoch = 0;
+    InitializeCriticalSection(&e->lock);
+    InitializeConditionVariable(&e->cond);
+}
+int my_prepareWait(my_eventcount* e) {
+    InterlockedIncrement(&e->waiters);
+    return (int)my_atomicLoad(&e->epoch);
+}
+void my_cancelWait(my_eventcount* e) {
+    InterlockedDecrement(&e->waiters);
+}
+void my_waitEvent(my_eventcount* e, int key) {
+    EnterCriticalSection(&e->lock);
+    while ((int)e->epoch == key) {
+        SleepConditionVariableCS(&e->cond, &e->lock, INFINITE);
+    }
+    LeaveCriticalSection(&e->lock);
+    InterlockedDecrement(&e->waiters);
+}
+int my_notifyEvent(my_eventcount* e, int n) {
+    if (my_atomicLoad(&e->waiters) == 0) {
+        return 0;
+    }
+    EnterCriticalSection(&e->lock);
+    e->epoch++;
+    LeaveCriticalSection(&e->lock);
+    if (n > 1) {
+        WakeAllConditionVariable(&e->cond);
+    }
+    else {
+        WakeConditionVariable(&e->cond);
+    }
+    return 1;
+}
+
+void* my_alignedAlloc(size_t align, size_t size) {
+    return _aligned_malloc(size, align);
+}
+void my_alignedFree(void* p) {
+    _aligned_free(p);
+}
+
+void my_sleep(unsigned int ms) {
+    Sleep(ms);
+}
+
+unsigned long long my_nowNs() {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart / freq.QuadPart) * 1000000000ULL +
+           (unsigned long long)(now.QuadPart % freq.QuadPart) * 1000000000ULL / freq.QuadPart;
+}
+void my_cpuRelax() {
+    YieldProcessor();
+}
+
+int my_bindThread(int cpu) {
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+        return -1;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) ? 0 : -1;
+}
+int my_unbindThread() {
+    // Windows上线程的绑定不影响进程的亲和性掩码
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        return -1;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), processMask) ? 0 : -1;
+}
+int my_cpuCount() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+int my_availableCpus() {
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) || processMask == 0) {
+        return my_cpuCount();
+    }
+    int n = 0;
+    for (; processMask; processMask &= processMask - 1) {
+        n++;
+    }
+    return n;
+}
+// Windows上网卡队列的中断分配由RSS配置决定，这里不读取
+int my_nicIrqCpus(const char* ifname, int* cpus, int max) {
+    (void)ifname;
+    (void)cpus;
+    (void)max;
+    return 0;
+}
+
 #else
 
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <unistd.h>
+
 my_mutex* my_createMutex()
 {
     my_mutex* m = (my_mutex*)malloc(sizeof(my_mutex));
@@ -78,6 +210,9 @@ void my_destroyMutex(my_mutex* m)
 void my_lockMutex(my_mutex* m) {
     pthread_mutex_lock(m);
 }
+int my_tryLockMutex(my_mutex* m) {
+    return pthread_mutex_trylock(m) == 0;
+}
 void my_unlockMutex(my_mutex* m) {
     pthread_mutex_unlock(m);
 }
@@ -86,21 +221,61 @@ my_semaphore* my_createSemaphore(unsigned int initialValue, unsigned int maxValu
     // maxValue参数在POSIX信号量中无效，仅用initialValue
     my_semaphore* s = (my_semaphore*)malloc(sizeof(my_semaphore));
     if (s) {
-        sem_init(s, 0, initialValue);
+        sem_init(&s->sem, 0, initialValue);
+        s->efd = -1;
+    }
+    return s;
+}
+my_semaphore* my_createPollableSemaphore(unsigned int initialValue, unsigned int maxValue) {
+    (void)maxValue;
+    my_semaphore* s = (my_semaphore*)malloc(sizeof(my_semaphore));
+    if (s) {
+        // eventfd不可用时退化为普通信号量
+        s->efd = eventfd(initialValue, EFD_SEMAPHORE | EFD_NONBLOCK);
+        sem_init(&s->sem, 0, s->efd < 0 ? initialValue : 0);
     }
     return s;
 }
 void my_destroySemaphore(my_semaphore* s) {
     if (s) {
-        sem_destroy(s);
+        sem_destroy(&s->sem);
+        if (s->efd >= 0) {
+            close(s->efd);
+        }
         free(s);
     }
 }
 void my_waitSemaphore(my_semaphore* s) {
-    sem_wait(s);
+    if (s->efd < 0) {
+        sem_wait(&s->sem);
+        return;
+    }
+    // eventfd为非阻塞，没拿到就等它可读再抢
+    uint64_t v;
+    while (read(s->efd, &v, sizeof(v)) != sizeof(v)) {
+        struct pollfd pfd;
+        pfd.fd = s->efd;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, -1);
+    }
+}
+// 不阻塞地尝试获取信号量，成功返回1
+int my_tryWaitSemaphore(my_semaphore* s) {
+    if (s->efd < 0) {
+        return sem_trywait(&s->sem) == 0;
+    }
+    uint64_t v;
+    return read(s->efd, &v, sizeof(v)) == sizeof(v);
 }
 void my_postSemaphore(my_semaphore* s) {
-    sem_post(s);
+    if (s->efd < 0) {
+        sem_post(&s->sem);
+        return;
+    }
+    uint64_t v = 1;
+    if (write(s->efd, &v, sizeof(v)) != sizeof(v)) {
+        perror("eventfd");
+    }
 }
 
 my_thread* my_createThread(void* (*start_routine)(void*), void* arg) {
@@ -115,4 +290,230 @@ unsigned long my_get_thread_id() {
     return (unsigned long)pthread_self();
 }
 
-#endif
\ No newline at end of file
+long my_atomicAdd(volatile long* p, long value) {
+    return __sync_fetch_and_add(p, value);
+}
+long my_atomicCas(volatile long* p, long expected, long desired) {
+    return __sync_val_compare_and_swap(p, expected, desired);
+}
+long my_atomicLoad(volatile long* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+void my_atomicStore(volatile long* p, long value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+void my_initEvent(my_eventcount* e) {
+    e->waiters = 0;
+    e->epoch = 0;
+}
+// 登记和读epoch都是全屏障，与通知方“先改条件再读waiters”配对，不会丢唤醒
+int my_prepareWait(my_eventcount* e) {
+    __sync_fetch_and_add(&e->waiters, 1);
+    return __atomic_load_n(&e->epoch, __ATOMIC_SEQ_CST);
+}
+void my_cancelWait(my_eventcount* e) {
+    __sync_fetch_and_sub(&e->waiters, 1);
+}
+void my_waitEvent(my_eventcount* e, int key) {
+    // epoch已经变了时FUTEX_WAIT立即返回EAGAIN
+    while (__atomic_load_n(&e->epoch, __ATOMIC_ACQUIRE) == key) {
+        syscall(SYS_futex, &e->epoch, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+    }
+    __sync_fetch_and_sub(&e->waiters, 1);
+}
+int my_notifyEvent(my_eventcount* e, int n) {
+    // 调用方刚用release写改了条件，这里要挡住写后读的重排
+    __sync_synchronize();
+    if (__atomic_load_n(&e->waiters, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+    __sync_fetch_and_add(&e->epoch, 1);
+    syscall(SYS_futex, &e->epoch, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+    return 1;
+}
+
+void* my_alignedAlloc(size_t align, size_t size) {
+    void* p = NULL;
+    if (posix_memalign(&p, align, size) != 0) {
+        return NULL;
+    }
+    return p;
+}
+void my_alignedFree(void* p) {
+    free(p);
+}
+
+void my_sleep(unsigned int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+unsigned long long my_nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+void my_cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// 第一次绑定之前线程的亲和性掩码，即进程启动时可用的CPU；Linux上主线程绑定后进程的掩码也跟着变，只能事先保存
+static cpu_set_t processSet;
+static volatile int processSetSaved = 0;
+
+int my_bindThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+    if (!processSetSaved && pthread_getaffinity_np(pthread_self(), sizeof(processSet), &processSet) == 0) {
+        processSetSaved = 1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+int my_unbindThread() {
+    if (!processSetSaved) {
+        return 0; // 从没绑定过
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(processSet), &processSet) == 0 ? 0 : -1;
+}
+int my_cpuCount() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+// cgroup v2的cpu.max为"配额 周期"，无限制时配额为max；v1分成cfs_quota_us和cfs_period_us两个文件，无限制时配额为-1
+static long cgroupCpuLimit() {
+    long quota = -1, period = 0;
+    char q[32];
+    FILE* fp = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (fp) {
+        if (fscanf(fp, "%31s %ld", q, &period) == 2 && strcmp(q, "max") != 0) {
+            quota = atol(q);
+        }
+        fclose(fp);
+    }
+    else {
+        fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+        if (fp) {
+            if (fscanf(fp, "%ld", &quota) != 1) {
+                quota = -1;
+            }
+            fclose(fp);
+        }
+        fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+        if (fp) {
+            if (fscanf(fp, "%ld", &period) != 1) {
+                period = 0;
+            }
+            fclose(fp);
+        }
+    }
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return (quota + period - 1) / period; // 配额不足一个CPU也按一个算
+}
+int my_availableCpus() {
+    cpu_set_t set;
+    int n = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : my_cpuCount();
+    long limit = cgroupCpuLimit();
+    if (limit > 0 && limit < n) {
+        n = (int)limit;
+    }
+    return n > 0 ? n : 1;
+}
+// 在/proc/interrupts中找名字里带ifname的中断（如eth0-TxRx-0），
+// 再从/proc/irq/N/smp_affinity_list取第一个CPU
+int my_nicIrqCpus(const char* ifname, int* cpus, int max) {
+    FILE* fp = fopen("/proc/interrupts", "r");
+    if (!fp) {
+        return 0;
+    }
+    char line[1024];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), fp)) {
+        char* colon = strchr(line, ':');
+        if (!colon || !strstr(colon, ifname)) {
+            continue;
+        }
+        int irq = atoi(line);
+        if (irq <= 0 && line[strspn(line, " ")] != '0') {
+            continue; // NMI、LOC等不是编号的行
+        }
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+        FILE* af = fopen(path, "r");
+        if (!af) {
+            continue;
+        }
+        int cpu;
+        if (fscanf(af, "%d", &cpu) == 1) {
+            cpus[n++] = cpu;
+        }
+        fclose(af);
+    }
+    fclose(fp);
+    return n;
+}
+
+#endif
+
+// 以下两个函数只依赖上面的平台接口，两个平台共用
+
+// 每自旋这么多次才读一次时钟
+#define SPIN_CHECK_INTERVAL 64
+
+int my_spinUntil(int (*poll)(void*), void* arg, unsigned int spinUs, unsigned long long* spentNs) {
+    unsigned long long start = my_nowNs();
+    unsigned long long deadline = start + (unsigned long long)spinUs * 1000ULL;
+    unsigned long long now = start;
+    int ok = 0;
+    while (spinUs > 0 && !ok) {
+        for (int i = 0; i < SPIN_CHECK_INTERVAL; i++) {
+            if (poll(arg)) {
+                ok = 1;
+                break;
+            }
+            my_cpuRelax();
+        }
+        now = my_nowNs();
+        if (now >= deadline) {
+            break;
+        }
+    }
+    if (ok) {
+        now = my_nowNs();
+    }
+    if (spentNs) {
+        *spentNs = now - start;
+    }
+    return ok;
+}
+
+int my_spinThenWait(my_eventcount* e, int (*poll)(void*), void* arg, unsigned int spinUs, unsigned long long* spentNs) {
+    int parks = 0;
+    if (my_spinUntil(poll, arg, spinUs, spentNs)) {
+        return 0;
+    }
+    while (!poll(arg)) {
+        int key = my_prepareWait(e);
+        if (poll(arg)) {
+            my_cancelWait(e);
+            break;
+        }
+        parks++;
+        my_waitEvent(e, key);
+    }
+    return parks;
+}
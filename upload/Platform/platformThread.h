@@ -1,3 +1,6 @@
+#ifndef PLATFORMTHREAD_H
+#define PLATFORMTHREAD_H
+
 #include "header.h"
 
 #ifdef _WIN32
@@ -10,35 +13,118 @@ typedef HANDLE my_semaphore;
 my_mutex* my_createMutex();
 void my_destroyMutex(my_mutex* m);
 void my_lockMutex(my_mutex* m);
+// 不阻塞地尝试加锁，成功返回1
+int my_tryLockMutex(my_mutex* m);
 void my_unlockMutex(my_mutex* m);
 
 my_semaphore* my_createSemaphore(unsigned int initialValue,unsigned int maxValue);
+// 可以和socket一起等待的信号量，见platformEvent.h中的my_waiter
+my_semaphore* my_createPollableSemaphore(unsigned int initialValue,unsigned int maxValue);
 void my_destroySemaphore(my_semaphore* m);
 void my_waitSemaphore(my_semaphore* s);
+int my_tryWaitSemaphore(my_semaphore* s);
 void my_postSemaphore(my_semaphore* s);
 
 my_thread* my_createThread(void* (*start_routine)(void*), void* arg);
 unsigned long my_get_thread_id();
 
+// 事件计数，等待方先登记再复查条件，通知方只在有人登记时才去唤醒
+typedef struct
+{
+    volatile long waiters;
+    volatile long epoch;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+} my_eventcount;
+
 #else
 #include <pthread.h>
 #include <semaphore.h>
 
 typedef pthread_t my_thread;
 typedef pthread_mutex_t my_mutex;
-typedef sem_t my_semaphore;
+typedef struct
+{
+    sem_t sem;
+    int efd; // 可轮询信号量使用的eventfd（EFD_SEMAPHORE），普通信号量为-1
+} my_semaphore;
 
 my_mutex* my_createMutex();
 void my_destroyMutex(my_mutex* m);
 void my_lockMutex(my_mutex* m);
+// 不阻塞地尝试加锁，成功返回1
+int my_tryLockMutex(my_mutex* m);
 void my_unlockMutex(my_mutex* m);
 
 my_semaphore* my_createSemaphore(unsigned int initialValue,unsigned int maxValue);
+// 可以和socket一起等待的信号量，见platformEvent.h中的my_waiter
+my_semaphore* my_createPollableSemaphore(unsigned int initialValue,unsigned int maxValue);
 void my_destroySemaphore(my_semaphore* m);
 void my_waitSemaphore(my_semaphore* s);
+int my_tryWaitSemaphore(my_semaphore* s);
 void my_postSemaphore(my_semaphore* s);
 
 my_thread* my_createThread(void* (*start_routine)(void*), void* arg);
 unsigned long my_get_thread_id();
 
-#endif
\ No newline at end of file
+// 事件计数，等待方先登记再复查条件，通知方只在有人登记时才去唤醒
+typedef struct
+{
+    volatile long waiters;
+    volatile int epoch; // futex字，每次通知加一
+} my_eventcount;
+
+#endif
+
+// 线程局部存储
+#ifdef _MSC_VER
+#define my_thread_local __declspec(thread)
+#else
+#define my_thread_local __thread
+#endif
+
+// 原子加，返回加之前的值，用于多线程共享的统计计数
+long my_atomicAdd(volatile long* p, long value);
+// 比较并交换，*p等于expected时写入desired，返回交换前的值
+long my_atomicCas(volatile long* p, long expected, long desired);
+// 带acquire语义的读和带release语义的写
+long my_atomicLoad(volatile long* p);
+void my_atomicStore(volatile long* p, long value);
+
+// 事件计数的用法：
+//   key = my_prepareWait(e); 复查条件，成立则my_cancelWait(e)，否则my_waitEvent(e, key)
+// my_notifyEvent在没有登记的等待者时只是一次原子读
+void my_initEvent(my_eventcount* e);
+int my_prepareWait(my_eventcount* e);
+void my_cancelWait(my_eventcount* e);
+void my_waitEvent(my_eventcount* e, int key);
+// 唤醒至多n个等待者，没有等待者返回0
+int my_notifyEvent(my_eventcount* e, int n);
+
+// 单调时钟，纳秒
+unsigned long long my_nowNs();
+// 自旋等待时让出流水线的提示指令（x86的pause）
+void my_cpuRelax();
+// 混合等待：先在spinUs微秒内反复调用poll(arg)，成功返回1，超时返回0
+// spentNs不为NULL时写入实际自旋的时间
+int my_spinUntil(int (*poll)(void*), void* arg, unsigned int spinUs, unsigned long long* spentNs);
+// 先自旋，超时后在事件计数e上挂起直到poll(arg)成功；返回挂起的次数，0表示自旋期间就等到了
+int my_spinThenWait(my_eventcount* e, int (*poll)(void*), void* arg, unsigned int spinUs, unsigned long long* spentNs);
+// 按align字节对齐分配内存，用my_alignedFree释放
+void* my_alignedAlloc(size_t align, size_t size);
+void my_alignedFree(void* p);
+// 毫秒级休眠
+void my_sleep(unsigned int ms);
+
+// 把当前线程绑定到指定CPU，失败返回-1
+int my_bindThread(int cpu);
+// 解除当前线程的绑定，恢复为进程启动时可用的全部CPU，失败返回-1
+int my_unbindThread();
+// 在线CPU个数
+int my_cpuCount();
+// 本进程实际可用的CPU个数：亲和性掩码中的CPU数，Linux上再受cgroup的CPU配额限制
+int my_availableCpus();
+// 网卡ifname各个收发队列中断所绑定的CPU，按队列顺序写入cpus，返回个数；不支持时返回0
+int my_nicIrqCpus(const char* ifname, int* cpus, int max);
+
+#endif
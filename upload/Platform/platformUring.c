@@ -0,0 +1,422 @@
+#include "platformUring.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define URING_BUF_GROUP 0
+#define URING_SEND_SLOTS 256
+
+// user_data的编码：高32位为请求类型，低32位为tag或发送槽位号
+#define URING_OP_RECV 1ULL
+#define URING_OP_SEND 2ULL
+#define URING_DATA(op, idx) (((op) << 32) | (uint32_t)(idx))
+
+typedef struct
+{
+    char* buf;
+    struct sockaddr_in addr;
+    struct iovec iov;
+    struct msghdr msg;
+    int next; // 空闲链表
+} uring_send_slot;
+
+struct my_uring
+{
+    int fd;
+    unsigned int sqEntries;
+
+    // SQ
+    unsigned int* sqHead;
+    unsigned int* sqTail;
+    unsigned int sqMask;
+    unsigned int* sqArray;
+    struct io_uring_sqe* sqes;
+    unsigned int sqLocalTail; // 已填好但还没提交的SQE
+    unsigned int toSubmit;
+
+    // CQ
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int cqMask;
+    struct io_uring_cqe* cqes;
+
+    void* ringPtr;
+    size_t ringSize;
+    size_t sqesSize;
+
+    // 接收缓冲区池
+    struct io_uring_buf_ring* bufRing;
+    size_t bufRingSize;
+    char* bufPool;
+    int bufCount;
+    int bufSize;
+    int bufMask;
+
+    // 每个tag对应的socket和multishot recvmsg模板
+    my_socket socks[MY_URING_MAX_SOCKS];
+    struct msghdr recvMsg[MY_URING_MAX_SOCKS];
+
+    // 发送槽位
+    uring_send_slot slots[URING_SEND_SLOTS];
+    int freeSlot;
+};
+
+static int uring_setup(unsigned int entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, void* arg, unsigned int nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+// 把第bid个接收缓冲区还给内核
+static void recycleBuffer(my_uring* u, int bid)
+{
+    unsigned short tail = u->bufRing->tail;
+    struct io_uring_buf* b = &u->bufRing->bufs[tail & u->bufMask];
+    b->addr = (unsigned long)(u->bufPool + (size_t)bid * u->bufSize);
+    b->len = u->bufSize;
+    b->bid = (unsigned short)bid;
+    __atomic_store_n(&u->bufRing->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static int submit(my_uring* u, unsigned int minComplete)
+{
+    __atomic_store_n(u->sqTail, u->sqLocalTail, __ATOMIC_RELEASE);
+    unsigned int n = u->toSubmit;
+    u->toSubmit = 0;
+    int ret;
+    do {
+        ret = uring_enter(u->fd, n, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+// 取一个空SQE，SQ满时先提交已有的请求
+static struct io_uring_sqe* getSqe(my_uring* u)
+{
+    unsigned int head = __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE);
+    if (u->sqLocalTail - head >= u->sqEntries) {
+        submit(u, 0);
+        head = __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE);
+        if (u->sqLocalTail - head >= u->sqEntries) {
+            return NULL;
+        }
+    }
+    unsigned int idx = u->sqLocalTail & u->sqMask;
+    struct io_uring_sqe* sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[idx] = idx;
+    u->sqLocalTail++;
+    u->toSubmit++;
+    return sqe;
+}
+
+my_uring* my_createUring(unsigned int entries, int bufCount, int bufSize)
+{
+    struct io_uring_params p;
+    my_uring* u = (my_uring*)calloc(1, sizeof(my_uring));
+    if (!u) {
+        return NULL;
+    }
+
+    memset(&p, 0, sizeof(p));
+    u->fd = uring_setup(entries, &p);
+    if (u->fd < 0) {
+        free(u);
+        return NULL;
+    }
+    // 需要内核把SQ和CQ映射到同一块内存（5.4+）
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(u->fd);
+        free(u);
+        return NULL;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ringSize = sqSize > cqSize ? sqSize : cqSize;
+    u->ringPtr = mmap(NULL, u->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->ringPtr == MAP_FAILED || u->sqes == MAP_FAILED) {
+        close(u->fd);
+        free(u);
+        return NULL;
+    }
+
+    char* ring = (char*)u->ringPtr;
+    u->sqEntries = p.sq_entries;
+    u->sqHead = (unsigned int*)(ring + p.sq_off.head);
+    u->sqTail = (unsigned int*)(ring + p.sq_off.tail);
+    u->sqMask = *(unsigned int*)(ring + p.sq_off.ring_mask);
+    u->sqArray = (unsigned int*)(ring + p.sq_off.array);
+    u->sqLocalTail = *u->sqTail;
+    u->cqHead = (unsigned int*)(ring + p.cq_off.head);
+    u->cqTail = (unsigned int*)(ring + p.cq_off.tail);
+    u->cqMask = *(unsigned int*)(ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(ring + p.cq_off.cqes);
+
+    // 接收缓冲区池，个数必须是2的幂
+    int count = 1;
+    while (count < bufCount && count < 32768) {
+        count <<= 1;
+    }
+    u->bufCount = count;
+    u->bufMask = count - 1;
+    u->bufSize = (int)(sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in)) + bufSize;
+    u->bufRingSize = count * sizeof(struct io_uring_buf);
+    u->bufRing = mmap(NULL, u->bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufPool = malloc((size_t)count * u->bufSize);
+    if (u->bufRing == MAP_FAILED || !u->bufPool) {
+        my_destroyUring(u);
+        return NULL;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)u->bufRing;
+    reg.ring_entries = count;
+    reg.bgid = URING_BUF_GROUP;
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        my_destroyUring(u);
+        return NULL;
+    }
+    u->bufRing->tail = 0;
+    for (int i = 0; i < count; i++) {
+        recycleBuffer(u, i);
+    }
+
+    // 发送槽位空闲链表
+    for (int i = 0; i < URING_SEND_SLOTS; i++) {
+        u->slots[i].buf = NULL;
+        u->slots[i].next = i + 1 < URING_SEND_SLOTS ? i + 1 : -1;
+    }
+    u->freeSlot = 0;
+    return u;
+}
+
+void my_destroyUring(my_uring* u)
+{
+    if (!u) {
+        return;
+    }
+    // 已排队还没提交的回包先交给内核，UDP发送在提交时就完成
+    if (u->toSubmit > 0) {
+        submit(u, 0);
+    }
+    for (int i = 0; i < URING_SEND_SLOTS; i++) {
+        free(u->slots[i].buf);
+    }
+    if (u->bufRing && u->bufRing != MAP_FAILED) {
+        munmap(u->bufRing, u->bufRingSize);
+    }
+    free(u->bufPool);
+    munmap(u->sqes, u->sqesSize);
+    munmap(u->ringPtr, u->ringSize);
+    close(u->fd);
+    free(u);
+}
+
+int my_uringRecv(my_uring* u, my_socket s, int tag)
+{
+    if (tag < 0 || tag >= MY_URING_MAX_SOCKS) {
+        return -1;
+    }
+    struct io_uring_sqe* sqe = getSqe(u);
+    if (!sqe) {
+        return -1;
+    }
+
+    // multishot recvmsg只用msghdr里的namelen/controllen描述缓冲区布局
+    u->socks[tag] = s;
+    memset(&u->recvMsg[tag], 0, sizeof(struct msghdr));
+    u->recvMsg[tag].msg_namelen = sizeof(struct sockaddr_in);
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = s;
+    sqe->addr = (unsigned long)&u->recvMsg[tag];
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = URING_DATA(URING_OP_RECV, tag);
+    return 0;
+}
+
+int my_uringSend(my_uring* u, my_socket s, const char* buf, int len, struct sockaddr_in* addr)
+{
+    int idx = u->freeSlot;
+    if (idx < 0 || len > u->bufSize) {
+        return -1;
+    }
+    uring_send_slot* slot = &u->slots[idx];
+    if (!slot->buf) {
+        slot->buf = malloc(u->bufSize);
+        if (!slot->buf) {
+            return -1;
+        }
+    }
+    struct io_uring_sqe* sqe = getSqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    u->freeSlot = slot->next;
+
+    memcpy(slot->buf, buf, len);
+    slot->iov.iov_base = slot->buf;
+    slot->iov.iov_len = len;
+    memset(&slot->msg, 0, sizeof(slot->msg));
+    if (addr) {
+        slot->addr = *addr;
+        slot->msg.msg_name = &slot->addr;
+        slot->msg.msg_namelen = sizeof(slot->addr);
+    }
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = s;
+    sqe->addr = (unsigned long)&slot->msg;
+    sqe->len = 1;
+    sqe->user_data = URING_DATA(URING_OP_SEND, idx);
+    return 0;
+}
+
+// 接收请求的完成事件是否表示多发接收已经终止且不能重挂：缓冲区池暂时用完（-ENOBUFS）和正常结束可以重挂
+static int recvFailed(struct io_uring_cqe* cqe)
+{
+    return (cqe->user_data >> 32) == URING_OP_RECV && !(cqe->flags & IORING_CQE_F_MORE) &&
+           cqe->res < 0 && cqe->res != -ENOBUFS;
+}
+
+int my_uringCheckRecv(my_uring* u)
+{
+    if (submit(u, 0) < 0) {
+        return -1;
+    }
+    // 不支持的请求在提交时就以错误完成，只看不取，留给my_uringWait处理
+    unsigned int tail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+    for (unsigned int head = *u->cqHead; head != tail; head++) {
+        struct io_uring_cqe* cqe = &u->cqes[head & u->cqMask];
+        if (recvFailed(cqe)) {
+            errno = -cqe->res;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int my_uringWait(my_uring* u, my_uringRecvCallback cb, void* arg)
+{
+    if (submit(u, 1) < 0) {
+        return -1;
+    }
+
+    int handled = 0;
+    int failed = 0;
+    unsigned int head = *u->cqHead;
+    unsigned int tail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &u->cqes[head & u->cqMask];
+        unsigned long long op = cqe->user_data >> 32;
+        int idx = (int)(cqe->user_data & 0xFFFFFFFF);
+        int res = cqe->res;
+        unsigned int flags = cqe->flags;
+        head++;
+        handled++;
+
+        if (op == URING_OP_SEND) {
+            u->slots[idx].next = u->freeSlot;
+            u->freeSlot = idx;
+            continue;
+        }
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            char* buf = u->bufPool + (size_t)bid * u->bufSize;
+            struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)buf;
+            if (res > 0 && !(out->flags & MSG_TRUNC)) {
+                struct sockaddr_in* from = (struct sockaddr_in*)(out + 1);
+                char* payload = (char*)(out + 1) + u->recvMsg[idx].msg_namelen + u->recvMsg[idx].msg_controllen;
+                cb(arg, idx, payload, (int)out->payloadlen, from);
+            }
+            recycleBuffer(u, bid);
+        }
+        // 多发请求被内核终止：缓冲区池暂时用完时重新挂上，其他错误重挂也只会立刻再失败
+        if (recvFailed(cqe)) {
+            failed = -res;
+        } else if (!(flags & IORING_CQE_F_MORE)) {
+            my_uringRecv(u, u->socks[idx], idx);
+        }
+    }
+    __atomic_store_n(u->cqHead, head, __ATOMIC_RELEASE);
+    if (failed) {
+        errno = failed;
+        return -1;
+    }
+    return handled;
+}
+
+#else
+
+my_uring* my_createUring(unsigned int entries, int bufCount, int bufSize)
+{
+    (void)entries;
+    (void)bufCount;
+    (void)bufSize;
+    return NULL;
+}
+
+void my_destroyUring(my_uring* u)
+{
+    (void)u;
+}
+
+int my_uringRecv(my_uring* u, my_socket s, int tag)
+{
+    (void)u;
+    (void)s;
+    (void)tag;
+    return -1;
+}
+
+int my_uringCheckRecv(my_uring* u)
+{
+    (void)u;
+    return -1;
+}
+
+int my_uringSend(my_uring* u, my_socket s, const char* buf, int len, struct sockaddr_in* addr)
+{
+    (void)u;
+    (void)s;
+    (void)buf;
+    (void)len;
+    (void)addr;
+    return -1;
+}
+
+int my_uringWait(my_uring* u, my_uringRecvCallback cb, void* arg)
+{
+    (void)u;
+    (void)cb;
+    (void)arg;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef PLATFORMURING_H
+#define PLATFORMURING_H
+
+#include "platformSocket.h"
+
+// 一个ring最多挂接收请求的socket数
+#define MY_URING_MAX_SOCKS 8
+
+// io_uring收发引擎，仅Linux支持，直接使用系统调用，不依赖liburing
+// 接收：每个socket挂一个multishot recvmsg，数据写入固定的缓冲区池（provided buffer ring）
+// 发送：先排队到固定的发送槽位，等待事件时和接收一起一次性提交
+typedef struct my_uring my_uring;
+
+// 收到一个报文时的回调，buf只在回调期间有效
+typedef void (*my_uringRecvCallback)(void* arg, int tag, char* buf, int len, struct sockaddr_in* addr);
+
+// 创建io_uring，bufCount个接收缓冲区，每个可容纳bufSize字节的报文；不支持时返回NULL
+my_uring* my_createUring(unsigned int entries, int bufCount, int bufSize);
+void my_destroyUring(my_uring* u);
+
+// 在socket上挂多发接收请求，tag会在回调中原样带回，范围[0, MY_URING_MAX_SOCKS)
+int my_uringRecv(my_uring* u, my_socket s, int tag);
+
+// 排队一个发送请求（数据会被拷贝），addr为NULL表示socket已connect，发送槽位用完时返回-1
+int my_uringSend(my_uring* u, my_socket s, const char* buf, int len, struct sockaddr_in* addr);
+
+// 提交排队的请求但不等待，检查接收请求有没有被内核直接拒绝（例如6.0之前的内核不支持multishot recvmsg）
+// 在my_uringRecv之后、第一次my_uringWait之前调用，被拒绝时返回-1，errno为原因
+int my_uringCheckRecv(my_uring* u);
+
+// 提交排队的请求并等待至少一个完成事件，对收到的每个报文调用cb，返回处理的完成事件数
+// 接收请求因缓冲区暂时用完以外的原因终止时不再重挂，返回-1，errno为原因，调用者应改用其他收包方式
+int my_uringWait(my_uring* u, my_uringRecvCallback cb, void* arg);
+
+#endif
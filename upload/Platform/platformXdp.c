@@ -0,0 +1,490 @@
+#include "platformXdp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDP_FRAME_SIZE 2048
+#define XDP_FRAME_COUNT 2048 // 填充环能放下所有帧，归还帧时不会溢出
+#define XDP_RING_SIZE 2048
+#define XDP_MAX_QUEUES 64
+#define XDP_MAX_ADDRS 64 // 地址表最多能放的本机地址数
+#define XDP_HDR_LEN 42 // 以太网14 + IPv4 20 + UDP 8
+
+typedef struct
+{
+    unsigned int* producer;
+    unsigned int* consumer;
+    void* desc;
+    unsigned int mask;
+    unsigned int local; // 本端尚未发布的生产/消费位置
+    void* map;
+    size_t mapSize;
+} xdp_ring;
+
+struct my_xdp
+{
+    int fd;
+    int mapFd;
+    int addrMapFd; // 本机地址表，目的地址不在表中的报文交给协议栈
+    int progFd;
+    int linkFd;
+    int native;
+    char* umem;
+    size_t umemSize;
+    xdp_ring fill;
+    xdp_ring comp;
+    xdp_ring rx;
+    xdp_ring tx;
+};
+
+static long sys_bpf(int cmd, union bpf_attr* attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+#define INSN(code, dst, src, off, imm) ((struct bpf_insn){(code), (dst), (src), (off), (imm)})
+
+// 生成XDP程序：满足条件的报文按收包队列号查xskmap重定向，队列上没有socket时XDP_PASS；
+// 目的地址不在addrMap中的（路过本机或发给别的服务的）、QR=1的（上游服务器的应答）都交给协议栈
+static int loadProgram(int mapFd, int addrMapFd)
+{
+    const int pass = 34;
+    struct bpf_insn prog[] = {
+        /* 0 */ INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0), // ctx，调用辅助函数后r1会被覆盖
+        /* 1 */ INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6, 0, 0),   // data
+        /* 2 */ INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_3, BPF_REG_6, 4, 0),   // data_end
+        /* 3 */ INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+        /* 4 */ INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_HDR_LEN + 3), // 到DNS头部的标志字节
+        /* 5 */ INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, pass - 6, 0),
+        /* 6 */ INSN(BPF_LDX | BPF_H | BPF_MEM, BPF_REG_5, BPF_REG_2, 12, 0),  // ethertype
+        /* 7 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 8, htons(0x0800)),
+        /* 8 */ INSN(BPF_LDX | BPF_B | BPF_MEM, BPF_REG_5, BPF_REG_2, 14, 0),  // 版本和首部长度
+        /* 9 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 10, 0x45),
+        /* 10 */ INSN(BPF_LDX | BPF_B | BPF_MEM, BPF_REG_5, BPF_REG_2, 23, 0), // 协议
+        /* 11 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 12, IPPROTO_UDP),
+        /* 12 */ INSN(BPF_LDX | BPF_H | BPF_MEM, BPF_REG_5, BPF_REG_2, 20, 0), // MF和片偏移
+        /* 13 */ INSN(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, htons(0x3FFF)),
+        /* 14 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 15, 0),
+        /* 15 */ INSN(BPF_LDX | BPF_H | BPF_MEM, BPF_REG_5, BPF_REG_2, 36, 0), // 目的端口
+        /* 16 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 17, htons(53)),
+        /* 17 */ INSN(BPF_LDX | BPF_B | BPF_MEM, BPF_REG_5, BPF_REG_2, 44, 0), // QR位
+        /* 18 */ INSN(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, 0x80),
+        /* 19 */ INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass - 20, 0),
+        /* 20 */ INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_5, BPF_REG_2, 30, 0), // 目的地址
+        /* 21 */ INSN(BPF_STX | BPF_W | BPF_MEM, BPF_REG_10, BPF_REG_5, -4, 0),
+        /* 22 */ INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0),
+        /* 23 */ INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4),
+        /* 24 */ INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, addrMapFd),
+        /* 25 */ INSN(0, 0, 0, 0, 0),
+        /* 26 */ INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem),
+        /* 27 */ INSN(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, pass - 28, 0),
+        /* 28 */ INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6, 16, 0), // rx_queue_index
+        /* 29 */ INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapFd),
+        /* 30 */ INSN(0, 0, 0, 0, 0),
+        /* 31 */ INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+        /* 32 */ INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        /* 33 */ INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        /* 34 */ INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+        /* 35 */ INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (unsigned long)prog;
+    attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+    attr.license = (unsigned long)"GPL";
+    return (int)sys_bpf(BPF_PROG_LOAD, &attr);
+}
+
+// 建本机地址表：绑定了具体地址时只放这一个，INADDR_ANY时放本机所有网卡的IPv4地址
+static int createAddrMap(unsigned int addr)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_HASH;
+    attr.key_size = sizeof(unsigned int);
+    attr.value_size = sizeof(char);
+    attr.max_entries = XDP_MAX_ADDRS;
+    int fd = (int)sys_bpf(BPF_MAP_CREATE, &attr);
+    if (fd < 0) {
+        return -1;
+    }
+
+    unsigned int addrs[XDP_MAX_ADDRS];
+    int count = 0;
+    if (addr != htonl(INADDR_ANY)) {
+        addrs[count++] = addr;
+    } else {
+        struct ifaddrs* list;
+        if (getifaddrs(&list) != 0) {
+            close(fd);
+            return -1;
+        }
+        for (struct ifaddrs* i = list; i && count < XDP_MAX_ADDRS; i = i->ifa_next) {
+            if (i->ifa_addr && i->ifa_addr->sa_family == AF_INET) {
+                addrs[count++] = ((struct sockaddr_in*)i->ifa_addr)->sin_addr.s_addr;
+            }
+        }
+        freeifaddrs(list);
+    }
+    if (count == 0) {
+        close(fd);
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+
+    char one = 1;
+    for (int i = 0; i < count; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = fd;
+        attr.key = (unsigned long)&addrs[i];
+        attr.value = (unsigned long)&one;
+        if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0) {
+            int err = errno;
+            close(fd);
+            errno = err;
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static int attachProgram(int progFd, int ifindex, unsigned int mode)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = progFd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = mode;
+    return (int)sys_bpf(BPF_LINK_CREATE, &attr);
+}
+
+static int mapRing(my_xdp* x, xdp_ring* r, struct xdp_ring_offset* off, size_t descSize, off_t pgoff)
+{
+    r->mapSize = off->desc + XDP_RING_SIZE * descSize;
+    r->map = mmap(NULL, r->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, x->fd, pgoff);
+    if (r->map == MAP_FAILED) {
+        r->map = NULL;
+        return -1;
+    }
+    r->producer = (unsigned int*)((char*)r->map + off->producer);
+    r->consumer = (unsigned int*)((char*)r->map + off->consumer);
+    r->desc = (char*)r->map + off->desc;
+    r->mask = XDP_RING_SIZE - 1;
+    return 0;
+}
+
+// 把帧还给内核，填充环的发布推迟到一轮处理结束
+static void refill(my_xdp* x, unsigned long long addr)
+{
+    unsigned long long* slots = (unsigned long long*)x->fill.desc;
+    slots[x->fill.local++ & x->fill.mask] = addr & ~(unsigned long long)(XDP_FRAME_SIZE - 1);
+}
+
+// 已发送完的帧回到填充环
+static void reclaim(my_xdp* x)
+{
+    unsigned int prod = __atomic_load_n(x->comp.producer, __ATOMIC_ACQUIRE);
+    unsigned int cons = x->comp.local;
+    unsigned long long* slots = (unsigned long long*)x->comp.desc;
+    for (; cons != prod; cons++) {
+        refill(x, slots[cons & x->comp.mask]);
+    }
+    x->comp.local = cons;
+    __atomic_store_n(x->comp.consumer, cons, __ATOMIC_RELEASE);
+}
+
+static unsigned short ipChecksum(const unsigned char* ip)
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons((unsigned short)~sum);
+}
+
+// 交换以太网、IP、UDP两端地址，把帧改成发回客户端的应答
+static void turnAround(unsigned char* frame, int payload)
+{
+    unsigned char tmp[6];
+    memcpy(tmp, frame, 6);
+    memcpy(frame, frame + 6, 6);
+    memcpy(frame + 6, tmp, 6);
+
+    unsigned char* ip = frame + 14;
+    memcpy(tmp, ip + 12, 4);
+    memcpy(ip + 12, ip + 16, 4);
+    memcpy(ip + 16, tmp, 4);
+    unsigned short total = htons((unsigned short)(20 + 8 + payload));
+    memcpy(ip + 2, &total, 2);
+    ip[8] = 64; // TTL
+    ip[10] = ip[11] = 0;
+    unsigned short check = ipChecksum(ip);
+    memcpy(ip + 10, &check, 2);
+
+    unsigned char* udp = frame + 34;
+    memcpy(tmp, udp, 2);
+    memcpy(udp, udp + 2, 2);
+    memcpy(udp + 2, tmp, 2);
+    unsigned short ulen = htons((unsigned short)(8 + payload));
+    memcpy(udp + 4, &ulen, 2);
+    udp[6] = udp[7] = 0; // IPv4下UDP校验和可以为0
+}
+
+my_xdp* my_createXdp(const char* ifname, int queue, unsigned int addr)
+{
+    int ifindex = (int)if_nametoindex(ifname);
+    if (ifindex == 0 || queue < 0 || queue >= XDP_MAX_QUEUES) {
+        errno = ENODEV;
+        return NULL;
+    }
+    my_xdp* x = (my_xdp*)calloc(1, sizeof(my_xdp));
+    if (!x) {
+        return NULL;
+    }
+    x->fd = x->mapFd = x->addrMapFd = x->progFd = x->linkFd = -1;
+
+    // UMEM：一整块按帧切分的内存，收发共用
+    x->umemSize = (size_t)XDP_FRAME_SIZE * XDP_FRAME_COUNT;
+    x->umem = mmap(NULL, x->umemSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (x->umem == MAP_FAILED) {
+        x->umem = NULL;
+        goto fail;
+    }
+    x->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (x->fd < 0) {
+        goto fail;
+    }
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (unsigned long)x->umem;
+    reg.len = x->umemSize;
+    reg.chunk_size = XDP_FRAME_SIZE;
+    int ringSize = XDP_RING_SIZE;
+    if (setsockopt(x->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) != 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ringSize, sizeof(ringSize)) != 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ringSize, sizeof(ringSize)) != 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_RX_RING, &ringSize, sizeof(ringSize)) != 0 ||
+        setsockopt(x->fd, SOL_XDP, XDP_TX_RING, &ringSize, sizeof(ringSize)) != 0) {
+        goto fail;
+    }
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(x->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) != 0 ||
+        mapRing(x, &x->fill, &off.fr, sizeof(unsigned long long), XDP_UMEM_PGOFF_FILL_RING) != 0 ||
+        mapRing(x, &x->comp, &off.cr, sizeof(unsigned long long), XDP_UMEM_PGOFF_COMPLETION_RING) != 0 ||
+        mapRing(x, &x->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) != 0 ||
+        mapRing(x, &x->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) != 0) {
+        goto fail;
+    }
+    for (int i = 0; i < XDP_FRAME_COUNT; i++) {
+        refill(x, (unsigned long long)i * XDP_FRAME_SIZE);
+    }
+    __atomic_store_n(x->fill.producer, x->fill.local, __ATOMIC_RELEASE);
+
+    // 拷贝模式在驱动模式和通用模式下都能用
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = ifindex;
+    sxdp.sxdp_queue_id = queue;
+    sxdp.sxdp_flags = XDP_COPY;
+    if (bind(x->fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) != 0) {
+        goto fail;
+    }
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(int);
+    attr.value_size = sizeof(int);
+    attr.max_entries = XDP_MAX_QUEUES;
+    x->mapFd = (int)sys_bpf(BPF_MAP_CREATE, &attr);
+    if (x->mapFd < 0) {
+        goto fail;
+    }
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = x->mapFd;
+    attr.key = (unsigned long)&queue;
+    attr.value = (unsigned long)&x->fd;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0) {
+        goto fail;
+    }
+    x->addrMapFd = createAddrMap(addr);
+    if (x->addrMapFd < 0) {
+        goto fail;
+    }
+    x->progFd = loadProgram(x->mapFd, x->addrMapFd);
+    if (x->progFd < 0) {
+        goto fail;
+    }
+    // 以link方式挂载，进程退出时内核自动卸下程序
+    x->native = 1;
+    x->linkFd = attachProgram(x->progFd, ifindex, XDP_FLAGS_DRV_MODE);
+    if (x->linkFd < 0) {
+        x->native = 0;
+        x->linkFd = attachProgram(x->progFd, ifindex, XDP_FLAGS_SKB_MODE);
+    }
+    if (x->linkFd < 0) {
+        goto fail;
+    }
+    return x;
+
+fail:;
+    int err = errno;
+    my_destroyXdp(x);
+    errno = err;
+    return NULL;
+}
+
+void my_destroyXdp(my_xdp* x)
+{
+    if (!x) {
+        return;
+    }
+    if (x->linkFd >= 0) {
+        close(x->linkFd);
+    }
+    if (x->progFd >= 0) {
+        close(x->progFd);
+    }
+    if (x->mapFd >= 0) {
+        close(x->mapFd);
+    }
+    if (x->addrMapFd >= 0) {
+        close(x->addrMapFd);
+    }
+    xdp_ring* rings[] = {&x->fill, &x->comp, &x->rx, &x->tx};
+    for (int i = 0; i < 4; i++) {
+        if (rings[i]->map) {
+            munmap(rings[i]->map, rings[i]->mapSize);
+        }
+    }
+    if (x->fd >= 0) {
+        close(x->fd);
+    }
+    if (x->umem) {
+        munmap(x->umem, x->umemSize);
+    }
+    free(x);
+}
+
+int my_xdpWait(my_xdp* x, my_xdpCallback cb, void* arg, int timeout)
+{
+    struct pollfd pfd = {x->fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout) < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    reclaim(x);
+
+    unsigned int prod = __atomic_load_n(x->rx.producer, __ATOMIC_ACQUIRE);
+    unsigned int cons = x->rx.local;
+    unsigned int txCons = __atomic_load_n(x->tx.consumer, __ATOMIC_ACQUIRE);
+    struct xdp_desc* rxDesc = (struct xdp_desc*)x->rx.desc;
+    struct xdp_desc* txDesc = (struct xdp_desc*)x->tx.desc;
+    int handled = 0;
+    int sent = 0;
+
+    for (; cons != prod; cons++, handled++) {
+        struct xdp_desc d = rxDesc[cons & x->rx.mask];
+        unsigned char* frame = (unsigned char*)x->umem + d.addr;
+        int reply = 0;
+        if (d.len > XDP_HDR_LEN) {
+            // XDP程序已经保证是不带选项的IPv4 UDP报文
+            int payload = ((frame[38] << 8) | frame[39]) - 8;
+            if (payload > (int)d.len - XDP_HDR_LEN) {
+                payload = (int)d.len - XDP_HDR_LEN;
+            }
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            memcpy(&addr.sin_addr, frame + 26, 4);
+            memcpy(&addr.sin_port, frame + 34, 2);
+            int room = XDP_FRAME_SIZE - (int)(d.addr & (XDP_FRAME_SIZE - 1)) - XDP_HDR_LEN;
+            if (payload > 0) {
+                reply = cb(arg, (char*)frame + XDP_HDR_LEN, payload, room, &addr);
+            }
+        }
+        // 发送环满了就放弃这个应答，客户端会重试
+        if (reply > 0 && x->tx.local - txCons < XDP_RING_SIZE) {
+            turnAround(frame, reply);
+            struct xdp_desc* t = &txDesc[x->tx.local++ & x->tx.mask];
+            t->addr = d.addr;
+            t->len = XDP_HDR_LEN + reply;
+            t->options = 0;
+            sent++;
+        } else {
+            refill(x, d.addr);
+        }
+    }
+    x->rx.local = cons;
+    __atomic_store_n(x->rx.consumer, cons, __ATOMIC_RELEASE);
+    __atomic_store_n(x->fill.producer, x->fill.local, __ATOMIC_RELEASE);
+    if (sent > 0) {
+        __atomic_store_n(x->tx.producer, x->tx.local, __ATOMIC_RELEASE);
+        // 拷贝模式下要由系统调用触发发送
+        sendto(x->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+    return handled;
+}
+
+const char* my_xdpMode(my_xdp* x)
+{
+    return x->native ? "native" : "generic";
+}
+
+#else
+
+my_xdp* my_createXdp(const char* ifname, int queue, unsigned int addr)
+{
+    (void)ifname;
+    (void)queue;
+    (void)addr;
+    return NULL;
+}
+
+void my_destroyXdp(my_xdp* x)
+{
+    (void)x;
+}
+
+int my_xdpWait(my_xdp* x, my_xdpCallback cb, void* arg, int timeout)
+{
+    (void)x;
+    (void)cb;
+    (void)arg;
+    (void)timeout;
+    return -1;
+}
+
+const char* my_xdpMode(my_xdp* x)
+{
+    (void)x;
+    return "none";
+}
+
+#endif
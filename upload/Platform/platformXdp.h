@@ -0,0 +1,27 @@
+#ifndef PLATFORMXDP_H
+#define PLATFORMXDP_H
+
+#include "platformSocket.h"
+
+// AF_XDP收包通道，仅Linux支持，直接使用bpf、AF_XDP系统调用，不依赖libbpf
+// 网卡上挂一个XDP程序，把发往本机地址UDP 53端口的IPv4 DNS查询（不带IP选项、不分片，QR=0）重定向到AF_XDP socket，
+// 其余报文（包括上游服务器的应答）照常交给内核协议栈；绑定的队列没有socket时也交给协议栈
+typedef struct my_xdp my_xdp;
+
+// 收到一个DNS报文时的回调：buf为UDP载荷，可以原地改写成应答，size为可写的最大长度，addr为客户端地址
+// 返回应答长度时直接从同一个帧发回客户端，返回0表示不回复（帧会还给内核）
+typedef int (*my_xdpCallback)(void* arg, char* buf, int len, int size, struct sockaddr_in* addr);
+
+// 在网卡ifname的queue号收包队列上创建通道，先尝试驱动模式，不支持时用通用（skb）模式
+// addr为DNS socket绑定的地址（网络字节序），INADDR_ANY表示本机所有IPv4地址
+// 失败返回NULL，errno为失败原因
+my_xdp* my_createXdp(const char* ifname, int queue, unsigned int addr);
+void my_destroyXdp(my_xdp* x);
+
+// 阻塞到有报文或超时（毫秒，-1表示一直等），处理所有已到达的报文，返回处理的报文数，出错返回-1
+int my_xdpWait(my_xdp* x, my_xdpCallback cb, void* arg, int timeout);
+
+// 通道使用的模式，"native"或"generic"
+const char* my_xdpMode(my_xdp* x);
+
+#endif
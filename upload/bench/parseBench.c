@@ -0,0 +1,88 @@
+#include "dns_message.h"
+#include "platformThread.h"
+
+// 报文解析微基准：同一个报文分别用get_message（逐个malloc）和get_message_arena（解析区）解析，
+// 对比每次解析的分配次数和耗时
+// 用法：parsebench [解析次数]
+// 分配次数通过替换malloc统计，只在glibc下可用，其他平台显示为-1
+
+int debug_mode = 0;
+int message_count = 0;
+
+#ifdef __GLIBC__
+static long allocs = 0;
+extern void *__libc_malloc(size_t size);
+void *malloc(size_t size)
+{
+    allocs++;
+    return __libc_malloc(size);
+}
+#define ALLOCS() allocs
+#define RESET_ALLOCS() (allocs = 0)
+#else
+#define ALLOCS() (-1L)
+#define RESET_ALLOCS()
+#endif
+
+// 构造www.example.com的A查询，answers不为0时构造带answers条A记录和一条OPT记录的应答
+static int buildMessage(uint8_t *buf, int answers)
+{
+    uint8_t *p = buf;
+    uint8_t header[DNS_HEADER_SIZE] = {0, 1, answers ? 0x81 : 0x01, answers ? 0x80 : 0, 0, 1, 0, answers, 0, 0, 0, answers ? 1 : 0};
+    memcpy(p, header, DNS_HEADER_SIZE);
+    p += DNS_HEADER_SIZE;
+    memcpy(p, "\3www\7example\3com\0\0\1\0\1", 21);
+    p += 21;
+    for (int i = 0; i < answers; i++)
+    {
+        uint8_t rr[16] = {0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 1, 2, 3, (uint8_t)i};
+        memcpy(p, rr, sizeof(rr));
+        p += sizeof(rr);
+    }
+    if (answers)
+    {
+        uint8_t opt[11] = {0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0};
+        memcpy(p, opt, sizeof(opt));
+        p += sizeof(opt);
+    }
+    return (int)(p - buf);
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 2000000;
+    static DnsArena arena;
+    uint8_t buf[MAX_DNS_SIZE];
+    DnsMessage msg;
+
+    printf("message               malloc(allocs, ns)   arena(allocs, ns)\n");
+    for (int k = 0; k < 2; k++)
+    {
+        int answers = k ? 4 : 0;
+        buildMessage(buf, answers);
+
+        RESET_ALLOCS();
+        unsigned long long start = my_nowNs();
+        for (long i = 0; i < n; i++)
+        {
+            get_message(&msg, buf, buf);
+            free_message(&msg);
+        }
+        double mallocNs = (double)(my_nowNs() - start) / n;
+        double mallocAllocs = (double)ALLOCS() / n;
+
+        RESET_ALLOCS();
+        start = my_nowNs();
+        for (long i = 0; i < n; i++)
+        {
+            get_message_arena(&msg, buf, buf, &arena);
+            free_message(&msg);
+        }
+        double arenaNs = (double)(my_nowNs() - start) / n;
+        double arenaAllocs = (double)ALLOCS() / n;
+
+        printf("%-20s  %6.1f  %10.0f    %6.1f  %9.0f\n", answers ? "reply (4 A + OPT)" : "query",
+               mallocAllocs, mallocNs, arenaAllocs, arenaNs);
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "taskRing.h"
+
+// 任务队列微基准：P个生产者线程、P个消费者线程共用一条容量为TASK_QUEUE_SIZE的队列，
+// 对比原来的互斥锁+两个信号量的队列和无锁环形队列（满/空时在事件计数上挂起）的吞吐
+// 用法：ringbench [每轮任务数]
+
+#define MAX_PAIRS 32
+
+int debug_mode = 0;
+
+// 原来的队列实现：每个报文一次加锁，外加一对信号量的等待和释放
+static Task mutexQueue[TASK_QUEUE_SIZE];
+static int mutexHead = 0, mutexTail = 0;
+static my_mutex *queueMutex;
+static my_semaphore *queueNotEmpty;
+static my_semaphore *queueNotFull;
+
+static void mutexAdd(Task *t)
+{
+    my_waitSemaphore(queueNotFull);
+    my_lockMutex(queueMutex);
+    mutexQueue[mutexTail] = *t;
+    mutexTail = (mutexTail + 1) % TASK_QUEUE_SIZE;
+    my_unlockMutex(queueMutex);
+    my_postSemaphore(queueNotEmpty);
+}
+
+static void mutexGet(Task *t)
+{
+    my_waitSemaphore(queueNotEmpty);
+    my_lockMutex(queueMutex);
+    *t = mutexQueue[mutexHead];
+    mutexHead = (mutexHead + 1) % TASK_QUEUE_SIZE;
+    my_unlockMutex(queueMutex);
+    my_postSemaphore(queueNotFull);
+}
+
+// 无锁队列，和工作线程一样只在队列满/空时挂起
+static TaskRing ring;
+static my_eventcount ringNotEmpty;
+static my_eventcount ringNotFull;
+
+static void ringAdd(Task *t)
+{
+    while (!ringTryEnqueue(&ring, t))
+    {
+        int key = my_prepareWait(&ringNotFull);
+        if (ringTryEnqueue(&ring, t))
+        {
+            my_cancelWait(&ringNotFull);
+            break;
+        }
+        my_waitEvent(&ringNotFull, key);
+    }
+    my_notifyEvent(&ringNotEmpty, 1);
+}
+
+static void ringGet(Task *t)
+{
+    while (!ringTryDequeue(&ring, t))
+    {
+        int key = my_prepareWait(&ringNotEmpty);
+        if (ringTryDequeue(&ring, t))
+        {
+            my_cancelWait(&ringNotEmpty);
+            break;
+        }
+        my_waitEvent(&ringNotEmpty, key);
+    }
+    my_notifyEvent(&ringNotFull, 1);
+}
+
+static void (*addFn)(Task *);
+static void (*getFn)(Task *);
+static long perProducer;
+static volatile long started, finished, go;
+
+static void waitGo()
+{
+    my_atomicAdd(&started, 1);
+    while (!my_atomicLoad(&go))
+    {
+        my_cpuRelax();
+    }
+}
+
+static void *producer(void *arg)
+{
+    Task t;
+    memset(&t, 0, sizeof(t));
+    t.len = 1;
+    waitGo();
+    for (long i = 0; i < perProducer; i++)
+    {
+        addFn(&t);
+    }
+    my_atomicAdd(&finished, 1);
+    return NULL;
+}
+
+// len为0的任务表示生产者都已结束，消费者退出
+static void *consumer(void *arg)
+{
+    Task t;
+    waitGo();
+    do
+    {
+        getFn(&t);
+    } while (t.len != 0);
+    my_atomicAdd(&finished, 1);
+    return NULL;
+}
+
+// 跑一轮，返回每秒完成的入队+出队对数（百万）
+static double runOnce(int pairs, long total)
+{
+    perProducer = total / pairs;
+    started = finished = go = 0;
+    for (int i = 0; i < pairs; i++)
+    {
+        my_createThread(producer, NULL);
+        my_createThread(consumer, NULL);
+    }
+    while (my_atomicLoad(&started) < 2 * pairs)
+    {
+        my_sleep(1);
+    }
+
+    unsigned long long start = my_nowNs();
+    my_atomicStore(&go, 1);
+    while (my_atomicLoad(&finished) < pairs)
+    {
+        my_sleep(1);
+    }
+    Task stop;
+    memset(&stop, 0, sizeof(stop));
+    for (int i = 0; i < pairs; i++)
+    {
+        addFn(&stop);
+    }
+    while (my_atomicLoad(&finished) < 2 * pairs)
+    {
+        my_sleep(1);
+    }
+    unsigned long long ns = my_nowNs() - start;
+    return (double)perProducer * pairs * 1000.0 / (double)ns;
+}
+
+int main(int argc, char *argv[])
+{
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+
+    queueMutex = my_createMutex();
+    queueNotEmpty = my_createSemaphore(0, TASK_QUEUE_SIZE);
+    queueNotFull = my_createSemaphore(TASK_QUEUE_SIZE, TASK_QUEUE_SIZE);
+    ringInit(&ring);
+    my_initEvent(&ringNotEmpty);
+    my_initEvent(&ringNotFull);
+
+    printf("%d CPU(s), %ld task(s) per run, queue size %d\n", my_cpuCount(), total, TASK_QUEUE_SIZE);
+    printf("threads  mutex+sem(Mops/s)  ring(Mops/s)\n");
+    for (int pairs = 1; pairs <= MAX_PAIRS; pairs *= 2)
+    {
+        addFn = mutexAdd;
+        getFn = mutexGet;
+        double m = runOnce(pairs, total);
+        addFn = ringAdd;
+        getFn = ringGet;
+        double r = runOnce(pairs, total);
+        printf("%7d  %17.2f  %12.2f\n", 2 * pairs, m, r);
+    }
+    return 0;
+}
@@ -2,7 +2,11 @@
 #include "header.h"
 #include "platformSocket.h"
 #include "multiThread.h"
+#include "eventLoop.h"
 #include "DNSHandle.h"
+#include "platformProcess.h"
+#include "xdpPath.h"
+#include <errno.h>
 
 my_socket servSock;
 struct sockaddr_in servSockAddr, remoteSockAddr;
@@ -21,14 +25,180 @@ int main(int argc, char *argv[])
         {
             if (strcmp(argv[i], "-dd") == 0)
             {
+                // 优先级最高，-d不会覆盖
                 debug_mode = 2;
-                // 优先级最高，遇到-dd直接break
                 argi = i + 1;
-                break;
             }
-            else if (strcmp(argv[i], "-d") == 0 && debug_mode < 2)
+            else if (strcmp(argv[i], "-d") == 0)
             {
-                debug_mode = 1;
+                if (debug_mode < 2)
+                {
+                    debug_mode = 1;
+                }
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-rb") == 0 && i + 1 < argc)
+            {
+                // 批量接收，每次recvmmsg最多取n个报文
+                recv_batch = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-sb") == 0 && i + 1 < argc)
+            {
+                // 批量发送，每个工作线程攒够n个回包再sendmmsg
+                send_batch = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-rp") == 0 && i + 1 < argc)
+            {
+                // n个SO_REUSEPORT分片，每个分片一个线程独立收包处理
+                shard_count = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+            {
+                // n个非阻塞事件循环线程，代替接收线程+线程池
+                event_loops = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-u") == 0)
+            {
+                // 事件循环使用io_uring引擎
+                use_uring = 1;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-cu") == 0)
+            {
+                // 每个工作线程/事件循环使用自己的已连接上游socket
+                connect_upstream = 1;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-fh") == 0)
+            {
+                // 按客户端地址哈希把查询分给工作线程，默认轮转
+                flow_hash = 1;
+                argi = i + 1;
+            }
+            else if ((strcmp(argv[i], "-rcpu") == 0 || strcmp(argv[i], "-wcpu") == 0) && i + 1 < argc)
+            {
+                // 接收线程/工作线程绑定的CPU列表，如0-3,8
+                int receiver = strcmp(argv[i], "-rcpu") == 0;
+                int n = parseCpuList(argv[++i], receiver ? receiver_cpus : worker_cpus, MAX_PLACEMENT_CPUS);
+                if (n < 0)
+                {
+                    printf("Invalid CPU list: %s\n", argv[i]);
+                    exit(0);
+                }
+                *(receiver ? &receiver_cpu_count : &worker_cpu_count) = n;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-irq") == 0 && i + 1 < argc)
+            {
+                // 按网卡收包队列的中断亲和性放置接收线程
+                if (loadNicIrqCpus(argv[++i]) == 0)
+                {
+                    printf("No IRQ affinity found for %s, receivers are not bound.\n", argv[i]);
+                }
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-spin") == 0 && i + 1 < argc)
+            {
+                // 空闲工作线程先自旋n微秒再挂起
+                spin_us = (unsigned int)atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-aqm") == 0 && i + 1 < argc)
+            {
+                // CoDel队列管理，目标排队时间n毫秒
+                aqm_target_us = (unsigned int)(atof(argv[++i]) * 1000);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-shed") == 0 && i + 1 < argc)
+            {
+                // 减载方式：drop直接丢弃，servfail/refused回对应的错误应答
+                i++;
+                if (strcmp(argv[i], "drop") == 0)
+                {
+                    shed_rcode = -1;
+                }
+                else if (strcmp(argv[i], "refused") == 0)
+                {
+                    shed_rcode = RCODE_REFUSED;
+                }
+                else
+                {
+                    shed_rcode = RCODE_SERVER_FAILURE;
+                }
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-pw") == 0 && i + 1 < argc)
+            {
+                // 优先级通道权重，0表示所有任务走同一条通道
+                priority_weight = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-fq") == 0)
+            {
+                // 拥塞时按客户端地址公平排队
+                fair_queue = 1;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-pf") == 0 && i + 1 < argc)
+            {
+                // 入口格式检查：drop丢弃（默认），formerr回FORMERR，off不检查
+                i++;
+                if (strcmp(argv[i], "off") == 0)
+                {
+                    prefilter = 0;
+                }
+                else if (strcmp(argv[i], "formerr") == 0)
+                {
+                    reject_rcode = RCODE_FORMAT_ERROR;
+                }
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-mp") == 0 && i + 1 < argc)
+            {
+                // n个工作进程，各自用SO_REUSEPORT绑定端口，共享只读的静态表
+                process_count = atoi(argv[++i]);
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-qs") == 0)
+            {
+                // 按查询域名在SO_REUSEPORT的socket之间分配报文
+                qname_steer = 1;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-xdp") == 0 && i + 1 < argc)
+            {
+                // 在网卡的收包队列上开AF_XDP快速通道，格式为网卡名[:队列号]
+                char *colon = strchr(argv[++i], ':');
+                if (colon)
+                {
+                    *colon = '\0';
+                    xdp_queue = atoi(colon + 1);
+                }
+                xdp_interface = argv[i];
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-ih") == 0)
+            {
+                // 接收线程直接回答命中缓存的A查询，只把未命中和上游应答交给工作线程
+                inline_handler = DNSAnswerInline;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            {
+                // 工作线程数min[:max]，只给一个数时固定大小，默认按可用CPU数确定
+                char *colon = strchr(argv[++i], ':');
+                pool_min = atoi(argv[i]);
+                pool_max = colon ? atoi(colon + 1) : pool_min;
+                argi = i + 1;
+            }
+            else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            {
+                // 每隔n秒输出一次运行统计
+                stats_interval = atoi(argv[++i]);
                 argi = i + 1;
             }
         }
@@ -49,6 +219,100 @@ int main(int argc, char *argv[])
         host_file_path[MAX_PATH_LEN - 1] = '\0';
     }
 
+    if (recv_batch < 1)
+    {
+        recv_batch = 1;
+    }
+    if (recv_batch > MY_MAX_BATCH)
+    {
+        recv_batch = MY_MAX_BATCH;
+    }
+    if (process_count > 1)
+    {
+        // 上游应答必须回到发出查询的进程，每个进程用自己的已连接上游socket
+        connect_upstream = 1;
+    }
+    if (use_uring && event_loops == 0)
+    {
+        event_loops = 1;
+    }
+    if (connect_upstream && shard_count > 0 && event_loops == 0)
+    {
+        // 分片线程还要等自己的上游socket，就是阻塞版的事件循环
+        event_loops = shard_count;
+    }
+    if (event_loops > MAX_SHARDS)
+    {
+        event_loops = MAX_SHARDS;
+    }
+    if (event_loops > 0)
+    {
+        // 每个事件循环优先使用自己的SO_REUSEPORT socket
+        shard_count = event_loops;
+    }
+    if (shard_count < 0)
+    {
+        shard_count = 0;
+    }
+    if (shard_count > MAX_SHARDS)
+    {
+        shard_count = MAX_SHARDS;
+    }
+    if (send_batch < 1)
+    {
+        send_batch = 1;
+    }
+    if (send_batch > MY_MAX_BATCH)
+    {
+        send_batch = MY_MAX_BATCH;
+    }
+    if (pool_min <= 0)
+    {
+        // 按cgroup配额和CPU亲和性得到的可用CPU数起步，最多扩到4倍
+        // 多进程时CPU由各进程平分
+        int cpus = my_availableCpus() / (process_count > 1 ? process_count : 1);
+        if (cpus < 1)
+        {
+            cpus = 1;
+        }
+        pool_min = cpus;
+        if (pool_max <= 0)
+        {
+            pool_max = cpus * 4;
+        }
+    }
+    if (pool_min > MAX_WORKERS)
+    {
+        pool_min = MAX_WORKERS;
+    }
+    if (pool_max > MAX_WORKERS)
+    {
+        pool_max = MAX_WORKERS;
+    }
+    if (pool_max < pool_min)
+    {
+        pool_max = pool_min;
+    }
+
+    // 多进程模式：静态表在fork之前读好放进共享内存，之后每个进程有自己的socket、缓存和ID表
+    int host_loaded = 0;
+    if (process_count > 1)
+    {
+        initLockAndSemaphore();
+        init_cache();
+        read_host();
+        host_loaded = 1;
+        if (share_static_records() < 0)
+        {
+            printf("Failed to map the shared host table, each process keeps its own copy.\n");
+        }
+        process_index = my_spawnWorkers(process_count);
+        if (process_index < 0)
+        {
+            printf("Multi-process mode is not supported, running as a single process.\n");
+        }
+    }
+
     message_count = 0;
     printf("Debug mode: ");
     switch (debug_mode)
@@ -76,6 +340,21 @@ int main(int argc, char *argv[])
 
     // inet将点分十进制的IPv4字符串转换为网络字节序的32位无符号整数（in_addr_t）
 
+    // 各进程绑定同一个端口，bind前必须开启SO_REUSEPORT
+    if (process_index >= 0 && my_setReusePort(servSock) != 0)
+    {
+        printf("SO_REUSEPORT is not supported, worker process %d exits.\n", process_index);
+        exit(1);
+    }
+
+    // 分片模式下所有socket都需要在bind前开启SO_REUSEPORT，不支持时退回线程池模式
+    if (shard_count > 0 && my_setReusePort(servSock) != 0)
+    {
+        printf("SO_REUSEPORT is not supported, %s.\n",
+               event_loops > 0 ? "event loops will share one socket" : "falling back to thread pool");
+        shard_count = 0;
+    }
+
     printf("Bind UDP port 53 ...");
     if (bind(servSock, (struct sockaddr *)&servSockAddr, sizeof(servSockAddr)) == -1)
     {
@@ -87,30 +366,148 @@ int main(int argc, char *argv[])
         printf("OK!\n");
     }
 
+    static Shard shards[MAX_SHARDS];
+    if (shard_count > 0)
+    {
+        shards[0].sock = servSock;
+        shards[0].handler = DNSHandle;
+        shards[0].index = 0;
+        for (int i = 1; i < shard_count; i++)
+        {
+            shards[i].sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            shards[i].handler = DNSHandle;
+            shards[i].index = i;
+            if (my_setReusePort(shards[i].sock) != 0 ||
+                bind(shards[i].sock, (struct sockaddr *)&servSockAddr, sizeof(servSockAddr)) == -1)
+            {
+                printf("Bind shard %d failed\n", i);
+                exit(0);
+            }
+        }
+        printf("SO_REUSEPORT shards: %d\n", shard_count);
+    }
+
+    // 组内socket总数：每个进程的分片数乘进程数；绑定晚的进程到齐之前，超出的选择由内核按四元组哈希处理
+    int group = (shard_count > 0 ? shard_count : 1) * (process_index >= 0 ? process_count : 1);
+    if (qname_steer && group > 1)
+    {
+        if (my_steerReusePort(servSock, group) == 0)
+        {
+            printf("Reuseport steering: by qname over %d socket(s)\n", group);
+        }
+        else
+        {
+            printf("Failed to load the qname steering program, using 4-tuple hashing.\n");
+            qname_steer = 0;
+        }
+    }
+
     // 3. 线程初始化
 
-    // 初始化锁和信号量
-    initLockAndSemaphore();
+    // 主线程是第0个接收线程，先绑核再初始化缓冲池，缓冲区落在接收线程的NUMA节点上；
+    // 线程会继承创建者的绑定，初始化完缓冲池先解除，等其他线程都创建完再绑回去
+    bindReceiver(0);
 
-    // 初始化线程池
-    my_thread *threads[THREAD_POOL_SIZE];
-    for (int i = 0; i < THREAD_POOL_SIZE; i++)
+    // 初始化锁和信号量，多进程模式下fork之前已经初始化过
+    if (!host_loaded)
     {
-        threads[i] = my_createThread(workerThread, DNSHandle);
+        initLockAndSemaphore();
+    }
+    // 会用到缓冲池的线程：工作线程、接收线程（分片、事件循环）、主线程和AF_XDP线程
+    initPacketPool(pool_max + shard_count + event_loops + 2);
+    unbindThread();
+
+    // 初始化线程池，分片模式和事件循环模式下不需要线程池
+    if (shard_count == 0 && event_loops == 0)
+    {
+        startWorkerPool(DNSHandle);
+        printf("Worker pool: %d", pool_min);
+        if (pool_max > pool_min)
+        {
+            printf(" (elastic up to %d)", pool_max);
+        }
+        printf(" threads\n");
     }
 
     // 4. 缓存动态表,本地静态表,ID表初始化
     init_ID_list();
-    init_cache();
-    read_host();
+    if (!host_loaded)
+    {
+        init_cache();
+        read_host();
+    }
+
+    if (stats_interval > 0)
+    {
+        my_createThread(statsThread, NULL);
+    }
+
+    // AF_XDP快速通道，多进程时只由第0个进程开启（一个队列只能绑一个socket）
+    static XdpPath xdpPath;
+    if (xdp_interface && process_index <= 0)
+    {
+        if (initXdpPath(&xdpPath, DNSHandle, DNSBuildInline) == 0)
+        {
+            printf("AF_XDP path on %s queue %d (%s mode)\n", xdp_interface, xdp_queue, my_xdpMode(xdpPath.xdp));
+            my_createThread(xdpThread, &xdpPath);
+        }
+        else
+        {
+            printf("AF_XDP path on %s is not available (%s), using sockets only.\n", xdp_interface, strerror(errno));
+            xdp_interface = NULL;
+        }
+    }
 
     printf("Initalization completed, starting operation.\n\n");
 
-    // 5. 主线程负责接收数据并投递到任务队列
+    // 5. 事件循环模式：主线程运行第0个事件循环，其余各起一个线程
+    if (event_loops > 0)
+    {
+        static EventLoop loops[MAX_SHARDS];
+        for (int i = 0; i < event_loops; i++)
+        {
+            if (initEventLoop(&loops[i], shard_count > 0 ? shards[i].sock : servSock, DNSHandle) != 0)
+            {
+                printf("Event loop %d initialization failed\n", i);
+                exit(0);
+            }
+            loops[i].index = i;
+        }
+        printf("Event loops: %d (%s)\n", event_loops, use_uring ? "io_uring" : "poll");
+        for (int i = 1; i < event_loops; i++)
+        {
+            my_createThread(eventLoopThread, &loops[i]);
+        }
+        eventLoopThread(&loops[0]);
+    }
+
+    // 分片模式：主线程负责第0个分片，其余分片各起一个线程
+    if (shard_count > 0)
+    {
+        for (int i = 1; i < shard_count; i++)
+        {
+            my_createThread(shardThread, &shards[i]);
+        }
+        shardThread(&shards[0]);
+    }
+
+    // 线程池模式：主线程负责接收数据并投递到任务队列
+    bindReceiver(0);
+    if (recv_batch > 1)
+    {
+        printf("Batched receive: up to %d packets per call\n", recv_batch);
+        receiveBatch(servSock);
+    }
+    PacketBuf *pkt = allocPacket(SIZE);
     for (;;)
     {
         Task t;
+        t.pkt = pkt;
+        t.buf = pkt->data;
         t.clientAddrLen = sizeof(t.clientAddr);
+        t.sock = servSock;
+        t.upstreamSock = servSock;
+        t.upstreamAddr = &remoteSockAddr;
 
         t.len = recvfrom(servSock, t.buf, SIZE, 0,
                          (struct sockaddr *)&t.clientAddr, &(t.clientAddrLen));
@@ -120,7 +517,10 @@ int main(int argc, char *argv[])
             perror("recvfrom");
             continue;
         }
+        stats_add(&stats.recv_calls, 1);
+        stats_add(&stats.recv_packets, 1);
         addTask(&t);
+        pkt = allocPacket(SIZE); // 原缓冲区已随任务交给工作线程
     }
 
     my_socketRelease();